@@ -21,19 +21,25 @@
 * DATA, OR PROFITS; OR BUSINESS INTERR
 */
 
+#include <stdlib.h>
+
 #include "xson/types.h"
 #include "xson/parser.h"
+#include "xson/path.h"
 
-static int xson_array_initialize(struct xson_element * e, struct xson_lex_element * lex) {
+static int xson_array_initialize(struct xson_context * ctx,
+                                 struct xson_element * e,
+                                 struct xson_lex_element * lex) {
     struct xson_array *array;
     
-    if ((e->internal = xson_malloc(&e->ctx->pool, sizeof(struct xson_array))) == NULL) {
+    if ((e->u.array = xson_malloc(&ctx->pool, sizeof(struct xson_array))) == NULL) {
         return XSON_RESULT_OOM;
     }
     
-    array = (struct xson_array *)e->internal;
+    array = e->u.array;
+    array->ctx = ctx;
     
-    if ((array->array = malloc(sizeof(struct xson_element *) * XSON_OBJECT_INIT_ARRAY_SIZE)) == NULL) {
+    if ((array->array = xson_malloc(&ctx->pool, sizeof(struct xson_element *) * XSON_OBJECT_INIT_ARRAY_SIZE)) == NULL) {
         return XSON_RESULT_OOM;
     }
     array->idx = 0;
@@ -41,34 +47,23 @@ static int xson_array_initialize(struct xson_element * e, struct xson_lex_elemen
     return XSON_RESULT_SUCCESS;
 }
 
-static void xson_array_destroy(struct xson_element * ele) {
-    int                 i;
-    struct xson_array   *array = ele->internal;
-    for (i = 0; i < array->idx; ++i) {
-        array->array[i]->ops->destroy(array->array[i]);
-    }
-    free(array->array);
-}
-
 static struct xson_element *
-xson_array_get_child(struct xson_element * ele, const char * expr) {
+xson_array_get_child(struct xson_element * ele, const char * expr,
+                     size_t len) {
     assert(ele != NULL);
-    assert(ele->internal != NULL);
+    assert(ele->u.array != NULL);
     struct xson_array   *array;
-    int                  is_array, idx;
+    size_t               keylen;
+    int                  idx;
 
-    if(ele == NULL || ele->internal == NULL)
+    if(ele == NULL || ele->u.array == NULL)
         return XSON_EXPR_NULL;
-    array = ele->internal;
+    array = ele->u.array;
 
-    is_array = xson_is_array_expression(expr);
-
-    if (!is_array)
+    /* the key is discarded */
+    if (!xson_parse_array_expression(expr, len, &keylen, &idx))
         return XSON_EXPR_INVALID_EXPR;
 
-    /* discard key */
-    sscanf(expr, "%*[^[][%d]", &idx);
-
     if (idx < 0 || idx >= array->idx)
         return XSON_EXPR_INDEX_OOR;
 
@@ -77,7 +72,7 @@ xson_array_get_child(struct xson_element * ele, const char * expr) {
 
 static int xson_array_add_child(struct xson_element * parent,
                                 struct xson_element * child) {
-    struct xson_array *array = (struct xson_array *)parent->internal;
+    struct xson_array *array = parent->u.array;
     if (child->type != ELE_TYPE_NUMBER &&
        child->type != ELE_TYPE_STRING &&
        child->type != ELE_TYPE_OBJECT &&
@@ -88,37 +83,62 @@ static int xson_array_add_child(struct xson_element * parent,
     }
     
     if (array->idx >= array->size && 
-        xson_buffer_grow((void **)&array->array,
-                         &array->size, array->idx,
-                         sizeof(struct xson_element *)) == -1) {
+        xson_pool_buffer_grow(&array->ctx->pool, (void **)&array->array,
+                              &array->size, array->idx,
+                              sizeof(struct xson_element *)) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
     array->array[array->idx++] = child;
-    child->parent = parent;
+    ++array->ctx->generation;
+    XSON_SET_PARENT(child, parent);
     return XSON_RESULT_SUCCESS;
 }
 
 static void xson_array_print(struct xson_element * ele, int level, int indent,
                              int dont_pad_on_first_line) {
     int                 i;
-    struct xson_array   *array = ele->internal;
+    struct xson_array   *array = ele->u.array;
     XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent), "[\n");
     for (i = 0; i < array->idx; ++i) {
         if (i)XSON_PADDING_PRINT(0, ",\n");
         assert(array->array[i]);
-        assert(array->array[i]->ops);
-        array->array[i]->ops->print(array->array[i], level + 1, indent, 0);
+        XSON_OPS(array->array[i])->print(array->array[i], level + 1, indent, 0);
         if (i == array->idx - 1)XSON_PADDING_PRINT(0, "\n");
     }
     XSON_PADDING_PRINT(level * indent, "]");
 }
 
+static int xson_array_freeze(struct xson_element * ele) {
+    int                 i, ret;
+    struct xson_array   *array = ele->u.array;
+
+    for (i = 0; i < array->idx; ++i) {
+        ret = XSON_OPS(array->array[i])->freeze(array->array[i]);
+        if (ret != XSON_RESULT_SUCCESS)
+            return ret;
+    }
+    return XSON_RESULT_SUCCESS;
+}
+
+static void xson_array_destroy(struct xson_context * ctx,
+                               struct xson_element * ele) {
+    int                 i;
+    struct xson_array   *array = ele->u.array;
+
+    for (i = 0; i < array->idx; ++i)
+        xson_element_destroy(ctx, array->array[i]);
+    xmpool_free(&ctx->pool, array->array,
+                array->size * sizeof(struct xson_element *));
+    xmpool_free(&ctx->pool, array, sizeof(struct xson_array));
+}
+
 struct xson_ele_operations array_ops =  {
     xson_array_initialize,
-    xson_array_destroy,
     xson_array_get_child,
     xson_array_add_child,
-    xson_array_print
+    xson_array_print,
+    xson_array_freeze,
+    xson_array_destroy
 };
 
 struct xson_element*
@@ -131,6 +151,27 @@ xson_array_get_elt(struct xson_array * array, int idx) {
     return array->array[idx];
 }
 
+int xson_array_remove_elt(struct xson_array * array, int idx) {
+    struct xson_element *elt;
+    assert(array != NULL);
+
+    if (array == NULL)
+        return XSON_RESULT_ERROR;
+    if (idx < 0 || idx >= array->idx)
+        return XSON_RESULT_OOR;
+
+    elt = array->array[idx];
+    if (array->ctx->frozen)
+        return XSON_RESULT_OP_NOTSUPPORTED;
+    xson_element_destroy(array->ctx, elt);
+    memmove(&array->array[idx], &array->array[idx + 1],
+            (array->idx - idx - 1) * sizeof(struct xson_element *));
+    --array->idx;
+    ++array->ctx->generation;
+
+    return XSON_RESULT_SUCCESS;
+}
+
 inline int xson_array_get_size(struct xson_array *array) {
     assert(array != NULL);
 
@@ -138,4 +179,227 @@ inline int xson_array_get_size(struct xson_array *array) {
         return XSON_RESULT_ERROR;
 
     return array->idx;
-}
\ No newline at end of file
+}
+
+void xson_array_iter_init(struct xson_array_iter * it, struct xson_array * array) {
+    assert(it != NULL);
+    assert(array != NULL);
+
+    it->array = array;
+    it->idx = 0;
+}
+
+int xson_array_iter_next(struct xson_array_iter * it, struct xson_element ** val) {
+    struct xson_array   *array = it->array;
+
+    if (array == NULL || it->idx >= array->idx)
+        return 0;
+    if (val)
+        *val = array->array[it->idx];
+    ++it->idx;
+    return 1;
+}
+
+/*
+* The hash of an integer field, the finalizer of MurmurHash3:
+* every bit of @num reaches the low bits the buckets are picked with,
+* IDs in steps of a power of 2 do not pile up in a few buckets.
+*/
+static unsigned xson_array_index_num_hash(long long num) {
+    unsigned long long h = (unsigned long long)num;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (unsigned)h;
+}
+
+/*
+* Fill @entry with the value of the field of an element.
+* Return: 1 if @elt is a string or an integer, 0 otherwise.
+*/
+static int xson_array_index_fill(struct xson_array_index_entry * entry,
+                                 struct xson_element * elt) {
+    char    *cp;
+
+    if (!XSON_GOOD_ELEMENT(elt))
+        return 0;
+    if (elt->type == ELE_TYPE_STRING) {
+        entry->type = ELE_TYPE_STRING;
+        entry->str = elt->u.string.start;
+        entry->len = elt->u.string.end - elt->u.string.start + 1;
+        entry->hash = xson_pair_ht_hash(entry->str, entry->len);
+        entry->num = 0;
+        return 1;
+    }
+    if (elt->type != ELE_TYPE_NUMBER)
+        return 0;
+    for (cp = elt->u.number.start; cp <= elt->u.number.end; ++cp)
+        if (*cp == '.' || *cp == 'e' || *cp == 'E')
+            return 0;
+    if (xson_number_to_llong(&elt->u.number, &entry->num) !=
+        XSON_RESULT_SUCCESS)
+        return 0;
+    entry->type = ELE_TYPE_NUMBER;
+    entry->str = NULL;
+    entry->len = 0;
+    entry->hash = xson_array_index_num_hash(entry->num);
+    return 1;
+}
+
+/*
+* Order the values: the numbers first, then the strings byte by byte.
+*/
+static int xson_array_index_cmp(const struct xson_array_index_entry * a,
+                                const struct xson_array_index_entry * b) {
+    int r;
+
+    if (a->type != b->type)
+        return a->type == ELE_TYPE_NUMBER ? -1 : 1;
+    if (a->type == ELE_TYPE_NUMBER)
+        return a->num < b->num ? -1 : a->num > b->num;
+    if ((r = memcmp(a->str, b->str, a->len < b->len ? a->len : b->len)))
+        return r;
+    return a->len < b->len ? -1 : a->len > b->len;
+}
+
+/* the elements with the same value stay in array order */
+static int xson_array_index_sort_cmp(const void * a, const void * b) {
+    const struct xson_array_index_entry *e1 = a, *e2 = b;
+    int                                 r = xson_array_index_cmp(e1, e2);
+
+    return r ? r : e1->pos - e2->pos;
+}
+
+struct xson_array_index *
+xson_array_build_index(struct xson_array * array, const char * expr,
+                       enum xson_array_index_kind kind) {
+    struct xson_context             *ctx;
+    struct xson_path                *path;
+    struct xson_array_index         *index;
+    struct xson_array_index_entry   *entries;
+    unsigned                        n_buckets = 1;
+    size_t                          size;
+    int                             i, n, *head;
+    assert(array != NULL);
+    assert(expr != NULL);
+
+    if (array == NULL || expr == NULL)
+        return NULL;
+    ctx = array->ctx;
+    if ((path = xson_path_compile_with_allocator(expr,
+                                                 ctx->pool.allocator)) == NULL)
+        return NULL;
+
+    /* room for every element, and twice as many buckets */
+    while (kind == XSON_ARRAY_INDEX_HASH &&
+           n_buckets < 2 * (unsigned)array->idx)
+        n_buckets <<= 1;
+    size = sizeof(struct xson_array_index) +
+           array->idx * sizeof(struct xson_array_index_entry) +
+           (kind == XSON_ARRAY_INDEX_HASH ? n_buckets * sizeof(int) : 0);
+    if ((index = xson_malloc(&ctx->pool, size)) == NULL) {
+        xson_path_free(path);
+        return NULL;
+    }
+    entries = (struct xson_array_index_entry *)(index + 1);
+    index->ctx = ctx;
+    index->kind = kind;
+    index->entries = entries;
+    index->buckets = NULL;
+    index->mask = n_buckets - 1;
+    index->generation = ctx->generation;
+    index->size = size;
+
+    for (i = 0, n = 0; i < array->idx; ++i) {
+        if (xson_array_index_fill(&entries[n],
+                                  xson_path_eval(array->array[i], path))) {
+            entries[n].pos = i;
+            entries[n].next = -1;
+            ++n;
+        }
+    }
+    index->n_entries = n;
+    xson_path_free(path);
+
+    if (kind == XSON_ARRAY_INDEX_SORTED) {
+        qsort(entries, n, sizeof(struct xson_array_index_entry),
+              xson_array_index_sort_cmp);
+        return index;
+    }
+    index->buckets = (int *)(entries + array->idx);
+    memset(index->buckets, 0xff, n_buckets * sizeof(int));
+    /* backwards, so that the first element of a value heads its chain */
+    for (i = n - 1; i >= 0; --i) {
+        head = &index->buckets[entries[i].hash & index->mask];
+        entries[i].next = *head;
+        *head = i;
+    }
+    return index;
+}
+
+/*
+* Return: see xson_array_index_find_string().
+* @key: the value looked up.
+*/
+static int xson_array_index_find(const struct xson_array_index * index,
+                                 const struct xson_array_index_entry * key) {
+    const struct xson_array_index_entry *entries = index->entries;
+    int                                 i, lo, hi;
+
+    if (index->generation != index->ctx->generation)
+        return XSON_RESULT_OP_NOTSUPPORTED;
+
+    if (index->kind == XSON_ARRAY_INDEX_HASH) {
+        for (i = index->buckets[key->hash & index->mask]; i >= 0;
+             i = entries[i].next)
+            if (entries[i].hash == key->hash &&
+                xson_array_index_cmp(&entries[i], key) == 0)
+                return entries[i].pos;
+        return XSON_RESULT_KEY_NOT_EXIST;
+    }
+
+    /* the first entry not below @key */
+    for (lo = 0, hi = index->n_entries; lo < hi; ) {
+        i = lo + (hi - lo) / 2;
+        if (xson_array_index_cmp(&entries[i], key) < 0)
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    if (lo < index->n_entries && xson_array_index_cmp(&entries[lo], key) == 0)
+        return entries[lo].pos;
+    return XSON_RESULT_KEY_NOT_EXIST;
+}
+
+int xson_array_index_find_string(const struct xson_array_index * index,
+                                 const char * str, size_t len) {
+    struct xson_array_index_entry key;
+
+    if (index == NULL || str == NULL)
+        return XSON_RESULT_ERROR;
+    key.type = ELE_TYPE_STRING;
+    key.str = str;
+    key.len = len;
+    key.hash = xson_pair_ht_hash(str, len);
+    return xson_array_index_find(index, &key);
+}
+
+int xson_array_index_find_llong(const struct xson_array_index * index,
+                                long long num) {
+    struct xson_array_index_entry key;
+
+    if (index == NULL)
+        return XSON_RESULT_ERROR;
+    key.type = ELE_TYPE_NUMBER;
+    key.num = num;
+    key.hash = xson_array_index_num_hash(num);
+    return xson_array_index_find(index, &key);
+}
+
+void xson_array_index_free(struct xson_array_index * index) {
+    if (index)
+        xmpool_free(&index->ctx->pool, index, index->size);
+}
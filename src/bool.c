@@ -24,16 +24,10 @@
 #include "xson/types.h"
 #include "xson/parser.h"
 
-static int xson_bool_initialize(struct xson_element * e,
+static int xson_bool_initialize(struct xson_context * ctx,
+                                struct xson_element * e,
                                 struct xson_lex_element * lex) {
-    struct xson_bool *xbool;
-
-    if ((e->internal = xson_malloc(&e->ctx->pool,
-                                   sizeof(struct xson_bool))) == NULL) {
-        return XSON_RESULT_OOM;
-    }
-
-    xbool = (struct xson_bool *)e->internal;
+    struct xson_bool *xbool = &e->u.xbool;
 
     if (strncmp(lex->start, "true", 4) == 0) {
         xbool->bool_val = 1;
@@ -43,12 +37,9 @@ static int xson_bool_initialize(struct xson_element * e,
     return XSON_RESULT_SUCCESS;
 }
 
-static void xson_bool_destroy(struct xson_element * ele) {
-    ;
-}
-
 static struct xson_element *
-xson_bool_get_child(struct xson_element * ele, const char * expr) {
+xson_bool_get_child(struct xson_element * ele, const char * expr,
+                    size_t len) {
     return XSON_EXPR_OP_NOTSUPPORTED;
 }
 
@@ -60,18 +51,27 @@ static int xson_bool_add_child(struct xson_element * parent,
 
 static void xson_bool_print(struct xson_element * ele, int level, int indent,
                      int dont_pad_on_first_line) {
-    struct xson_bool    *xbool = ele->internal;
+    struct xson_bool    *xbool = &ele->u.xbool;
 
     XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent), 
                        "%s", xbool->bool_val ? "true" : "false");
 }
 
+static int xson_bool_freeze(struct xson_element * ele) {
+    return XSON_RESULT_SUCCESS;
+}
+
+static void xson_bool_destroy(struct xson_context * ctx,
+                              struct xson_element * ele) {
+}
+
 struct xson_ele_operations bool_ops =  {
     xson_bool_initialize,
-    xson_bool_destroy,
     xson_bool_get_child,
     xson_bool_add_child,
-    xson_bool_print
+    xson_bool_print,
+    xson_bool_freeze,
+    xson_bool_destroy
 };
 
 int xson_bool_to_int(struct xson_bool * xbool, int *out){
@@ -22,7 +22,8 @@
 */
 #include "xson/common.h"
 
-int xson_buffer_grow(void ** buffer, int *old_len, int len, int ele_size) {
+int xson_buffer_grow(const struct xmpool_allocator_t * allocator,
+                     void ** buffer, int *old_len, int len, int ele_size) {
     void    *new_buffer;
     int     new_len = *old_len;
     
@@ -31,7 +32,7 @@ int xson_buffer_grow(void ** buffer, int *old_len, int len, int ele_size) {
         new_len <<= 1;
     }
     //printf("Expanding old buffer %p with size %d to new size %d.\n", *buffer, *old_len * ele_size, new_len * ele_size);
-    if((new_buffer = realloc(*buffer, new_len * ele_size)) == NULL) {
+    if((new_buffer = XM_REALLOC(allocator, *buffer, new_len * ele_size)) == NULL) {
         return XSON_RESULT_OOM;
     }
     //printf("new buffer address: %p.\n", new_buffer);
@@ -41,6 +42,24 @@ int xson_buffer_grow(void ** buffer, int *old_len, int len, int ele_size) {
     return XSON_RESULT_SUCCESS;
 }
 
+int xson_pool_buffer_grow(struct xmpool_t * pool, void ** buffer,
+                          int *old_len, int len, int ele_size) {
+    void    *new_buffer;
+    int     new_len = *old_len;
+
+    while(new_len <= len) {
+        new_len <<= 1;
+    }
+    if((new_buffer = xmpool_realloc(pool, *buffer, *old_len * ele_size,
+                                    new_len * ele_size)) == NULL) {
+        return XSON_RESULT_OOM;
+    }
+    *buffer = new_buffer;
+    *old_len = new_len;
+
+    return XSON_RESULT_SUCCESS;
+}
+
 int xson_is_number_start(char ch) {
     return ch == '-' || (ch >= '0' && ch <= '9');
 }
@@ -50,9 +69,5 @@ inline int xson_is_blanks(char ch) {
 }
 
 inline void * xson_malloc(struct xmpool_t * pool, size_t size) {
-    if(size > pool->chunk_size) {
-        assert(0);
-        return NULL;
-    }
     return xmpool_alloc(pool, size);
 }
\ No newline at end of file
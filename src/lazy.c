@@ -0,0 +1,318 @@
+/*
+* Copyright (c) 2014 Xinjing Cho
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+* 3. The name of the author may not be used to endorse or promote products
+*    derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERR
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "xson/parser.h"
+#include "xson/fsm_string.h"
+#include "xson/fsm_number.h"
+#include "xson/lazy.h"
+
+/* what may come next while validating */
+#define XSON_LAZY_VALUE     0x01
+#define XSON_LAZY_KEY       0x02
+#define XSON_LAZY_COLON     0x04
+#define XSON_LAZY_COMMA     0x08
+#define XSON_LAZY_CLOSE     0x10
+
+/* what may follow a value, @top is the innermost node open, -1 if none */
+#define XSON_LAZY_AFTER_VALUE(top) ((top) < 0 ? 0 : XSON_LAZY_COMMA | XSON_LAZY_CLOSE)
+
+/* the same as xson_is_blanks(), expanded in place on the hot paths */
+#define XSON_LAZY_IS_BLANK(c) ((c) == ' ' || (c) == '\n' || (c) == '\r' || (c) == '\t')
+#define XSON_LAZY_SKIP_BLANKS(cp) while (XSON_LAZY_IS_BLANK(*(cp))) ++(cp)
+
+int xson_parse_lazy(struct xson_context * ctx) {
+    struct xson_lazy_node   *nodes;
+    /* the nodes of the objects and arrays open */
+    int                     *open;
+    int                     n = 0, len = XSON_CTX_INIT_STK_LEN;
+    int                     depth = 0, open_len = XSON_CTX_INIT_STK_LEN;
+    int                     expect = XSON_LAZY_VALUE, top = -1;
+    int                     ret = XSON_RESULT_INVALID_JSON;
+    char                    *buf, *cp, *end;
+    struct fsm_string       fsms;
+    struct fsm_number       fsmn;
+    assert(ctx != NULL);
+
+    if (ctx->lazy)
+        return XSON_RESULT_SUCCESS;
+
+    nodes = xson_malloc(&ctx->pool, len * sizeof(struct xson_lazy_node));
+    open = xson_malloc(&ctx->pool, open_len * sizeof(int));
+    if (nodes == NULL || open == NULL) {
+        ret = XSON_RESULT_OOM;
+        goto out;
+    }
+
+    for (buf = cp = ctx->str_buf; ; ++cp) {
+        XSON_LAZY_SKIP_BLANKS(cp);
+        if (*cp == '\0')
+            break;
+
+        switch (*cp) {
+        case '{':
+        case '[':
+            if (!(expect & XSON_LAZY_VALUE))
+                goto out;
+            if ((n >= len &&
+                 xson_pool_buffer_grow(&ctx->pool, (void **)&nodes, &len, n,
+                                       sizeof(struct xson_lazy_node))) ||
+                (depth >= open_len &&
+                 xson_pool_buffer_grow(&ctx->pool, (void **)&open, &open_len,
+                                       depth, sizeof(int)))) {
+                ret = XSON_RESULT_OOM;
+                goto out;
+            }
+            nodes[n].start = cp - buf;
+            nodes[n].end = nodes[n].next = -1;
+            open[depth++] = top = n++;
+            expect = (*cp == '{' ? XSON_LAZY_KEY : XSON_LAZY_VALUE) |
+                     XSON_LAZY_CLOSE;
+            break;
+        case '}':
+        case ']':
+            if (!(expect & XSON_LAZY_CLOSE) ||
+                buf[nodes[top].start] != (*cp == '}' ? '{' : '['))
+                goto out;
+            nodes[top].end = cp - buf;
+            nodes[top].next = n;
+            top = --depth > 0 ? open[depth - 1] : -1;
+            expect = XSON_LAZY_AFTER_VALUE(top);
+            break;
+        case '\"':
+            if (expect & XSON_LAZY_KEY)
+                expect = XSON_LAZY_COLON;
+            else if ((expect & XSON_LAZY_VALUE) && top >= 0)
+                expect = XSON_LAZY_AFTER_VALUE(top);
+            else
+                goto out;
+            /* the state machine is only needed for the escapes */
+            for (end = cp + 1; *end != '\"' && *end != '\\' && *end; ++end)
+                ;
+            if (*end == '\"')
+                cp = end;
+            else if (fsm_string_run(&fsms, &cp) == XSON_RESULT_INVALID_JSON)
+                goto out;
+            break;
+        case ':':
+            if (!(expect & XSON_LAZY_COLON))
+                goto out;
+            expect = XSON_LAZY_VALUE;
+            break;
+        case ',':
+            if (!(expect & XSON_LAZY_COMMA))
+                goto out;
+            expect = buf[nodes[top].start] == '{' ? XSON_LAZY_KEY
+                                                   : XSON_LAZY_VALUE;
+            break;
+        default:
+            if (!(expect & XSON_LAZY_VALUE) || top < 0)
+                goto out;
+            if (xson_is_number_start(*cp)) {
+                if (fsm_number_run(&fsmn, &cp) == XSON_RESULT_INVALID_JSON)
+                    goto out;
+            } else if (!strncmp(cp, "true", 4) || !strncmp(cp, "null", 4)) {
+                cp += 3;
+            } else if (!strncmp(cp, "false", 5)) {
+                cp += 4;
+            } else {
+                goto out;
+            }
+            expect = XSON_LAZY_AFTER_VALUE(top);
+            break;
+        }
+    }
+
+    /* a single object or array */
+    if (n > 0 && depth == 0) {
+        ctx->lazy = nodes;
+        ctx->lazy_len = n;
+        ret = XSON_RESULT_SUCCESS;
+    }
+out:
+    if (open)
+        xmpool_free(&ctx->pool, open, open_len * sizeof(int));
+    if (ret != XSON_RESULT_SUCCESS && nodes)
+        xmpool_free(&ctx->pool, nodes, len * sizeof(struct xson_lazy_node));
+    return ret;
+}
+
+/*
+* Return: the byte after the string opened at @cp.
+*/
+static char * xson_lazy_skip_string(char * cp) {
+    for (++cp; *cp != '\"'; ++cp)
+        if (*cp == '\\')
+            ++cp;
+    return cp + 1;
+}
+
+/*
+* Return: the byte after the value at @cp.
+* @node: the node of the first object or array from @cp on,
+*        moved past the value if it is one.
+*/
+static char * xson_lazy_skip_value(struct xson_context * ctx, char * cp,
+                                   int * node) {
+    if (*cp == '{' || *cp == '[') {
+        cp = ctx->str_buf + ctx->lazy[*node].end + 1;
+        *node = ctx->lazy[*node].next;
+        return cp;
+    }
+    if (*cp == '\"')
+        return xson_lazy_skip_string(cp);
+    while (*cp && *cp != ',' && *cp != '}' && *cp != ']' &&
+           !XSON_LAZY_IS_BLANK(*cp))
+        ++cp;
+    return cp;
+}
+
+/*
+* Take a step from the object or array of node @*node at @*cpp,
+* the members or elements before the one looked up are skipped.
+* Return: XSON_EXPR_NULL on success, with @*cpp at the value found and
+*         @*node the node of the first object or array from there on,
+*         the XSON_EXPR_* error otherwise.
+*/
+static struct xson_element *
+xson_lazy_step(struct xson_context * ctx, const struct xson_path_step * step,
+               char ** cpp, int * node) {
+    char    *cp = *cpp, *key;
+    int     i, match, child = *node + 1;
+
+    if (*cp != (step->key ? '{' : '['))
+        return XSON_EXPR_TYPE_MISMATCH;
+
+    for (i = 0, ++cp; ; ++i) {
+        XSON_LAZY_SKIP_BLANKS(cp);
+        if (*cp == '}' || *cp == ']')
+            return step->key ? XSON_EXPR_KEY_NOT_EXIST : XSON_EXPR_INDEX_OOR;
+        if (step->key) {
+            key = cp + 1;
+            cp = xson_lazy_skip_string(cp);
+            match = (size_t)(cp - 1 - key) == step->len &&
+                    memcmp(key, step->key, step->len) == 0;
+            /* the colon */
+            XSON_LAZY_SKIP_BLANKS(cp);
+            ++cp;
+            XSON_LAZY_SKIP_BLANKS(cp);
+        } else {
+            match = i == step->index;
+        }
+        if (match) {
+            *cpp = cp;
+            *node = child;
+            return XSON_EXPR_NULL;
+        }
+        cp = xson_lazy_skip_value(ctx, cp, &child);
+        XSON_LAZY_SKIP_BLANKS(cp);
+        if (*cp == ',')
+            ++cp;
+    }
+}
+
+/*
+* Build the element of the value at @cp in the pool of the context.
+* Return: the element, XSON_EXPR_OOM if out of memory,
+*         XSON_EXPR_OP_NOTSUPPORTED if xson_parse() rejects the value.
+* @node: the node of the value if it is an object or array.
+*/
+static struct xson_element *
+xson_lazy_materialize(struct xson_context * ctx, char * cp, int node) {
+    struct xson_element *e;
+    int                 ret;
+
+    if ((e = xson_malloc(&ctx->pool, sizeof(struct xson_element))) == NULL)
+        return XSON_EXPR_OOM;
+    memset(e, 0, sizeof(struct xson_element));
+
+    switch (*cp) {
+    case '{':
+    case '[':
+        /* parsed under a root of its own */
+        e->type = ELE_TYPE_ROOT;
+        if (XSON_OPS(e)->initialize(ctx, e, NULL) != XSON_RESULT_SUCCESS)
+            return XSON_EXPR_OOM;
+        ret = xson_parse_range(ctx, e, cp,
+                               ctx->str_buf + ctx->lazy[node].end + 1);
+        if (ret != XSON_RESULT_SUCCESS)
+            return ret == XSON_RESULT_OOM ? XSON_EXPR_OOM
+                                          : XSON_EXPR_OP_NOTSUPPORTED;
+        return e->u.value.child;
+    case '\"':
+        e->type = ELE_TYPE_STRING;
+        e->u.string.start = cp + 1;
+        e->u.string.end = xson_lazy_skip_string(cp) - 2;
+        break;
+    case 't':
+    case 'f':
+        e->type = ELE_TYPE_BOOL;
+        e->u.xbool.bool_val = *cp == 't';
+        break;
+    case 'n':
+        e->type = ELE_TYPE_NULL;
+        break;
+    default:
+        e->type = ELE_TYPE_NUMBER;
+        e->u.number.start = cp;
+        e->u.number.end = xson_lazy_skip_value(ctx, cp, &node) - 1;
+        break;
+    }
+    return e;
+}
+
+struct xson_element * xson_lazy_eval(struct xson_context * ctx,
+                                     const struct xson_path * path) {
+    struct xson_element *err;
+    char                *cp;
+    int                 i, node = 0;
+
+    if (ctx == NULL || path == NULL || ctx->lazy == NULL)
+        return XSON_EXPR_NULL;
+
+    cp = ctx->str_buf + ctx->lazy[0].start;
+    for (i = 0; i < path->n_steps; ++i)
+        if ((err = xson_lazy_step(ctx, &path->steps[i], &cp, &node)) !=
+            XSON_EXPR_NULL)
+            return err;
+
+    return xson_lazy_materialize(ctx, cp, node);
+}
+
+struct xson_element * xson_lazy_get(struct xson_context * ctx,
+                                    const char * expr) {
+    struct xson_path    *path;
+    struct xson_element *e;
+
+    if (ctx == NULL || expr == NULL || ctx->lazy == NULL)
+        return XSON_EXPR_NULL;
+    if ((path = xson_path_compile_with_allocator(expr,
+                                                 ctx->pool.allocator)) == NULL)
+        return XSON_EXPR_INVALID_EXPR;
+
+    e = xson_lazy_eval(ctx, path);
+    xson_path_free(path);
+    return e;
+}
@@ -24,17 +24,15 @@
 #include "xson/types.h"
 #include "xson/parser.h"
 
-static int xson_null_initialize(struct xson_element * e,
+static int xson_null_initialize(struct xson_context * ctx,
+                                struct xson_element * e,
                                 struct xson_lex_element * lex) {
     return XSON_RESULT_SUCCESS;
 }
 
-static void xson_null_destroy(struct xson_element * ele) {
-    ;
-}
-
 static struct xson_element *
-xson_null_get_child(struct xson_element * ele, const char * expr) {
+xson_null_get_child(struct xson_element * ele, const char * expr,
+                    size_t len) {
     return XSON_EXPR_NULL;
 }
 
@@ -49,10 +47,19 @@ static void xson_null_print(struct xson_element * ele, int level, int indent,
     XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent), "null");
 }
 
+static int xson_null_freeze(struct xson_element * ele) {
+    return XSON_RESULT_SUCCESS;
+}
+
+static void xson_null_destroy(struct xson_context * ctx,
+                              struct xson_element * ele) {
+}
+
 struct xson_ele_operations null_ops =  {
     xson_null_initialize,
-    xson_null_destroy,
     xson_null_get_child,
     xson_null_add_child,
-    xson_null_print
+    xson_null_print,
+    xson_null_freeze,
+    xson_null_destroy
 };
\ No newline at end of file
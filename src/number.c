@@ -27,24 +27,19 @@
 #include "xson/types.h"
 #include "xson/parser.h"
 
-static int xson_number_initialize(struct xson_element * e,
+static int xson_number_initialize(struct xson_context * ctx,
+                                  struct xson_element * e,
                                   struct xson_lex_element * lex) {
-    struct xson_number * number;
-    if ((e->internal = xson_malloc(&e->ctx->pool, sizeof(struct xson_number))) == NULL) {
-        return XSON_RESULT_OOM;
-    }
-    number = (struct xson_number *)e->internal;
+    struct xson_number * number = &e->u.number;
+
     number->start = lex->start;
     number->end = lex->end;
     return XSON_RESULT_SUCCESS;
 }
 
-static void xson_number_destroy(struct xson_element * ele) {
-    ;
-}
-
 static struct xson_element *
-xson_number_get_child(struct xson_element * ele, const char * expr) {
+xson_number_get_child(struct xson_element * ele, const char * expr,
+                      size_t len) {
     return XSON_EXPR_OP_NOTSUPPORTED;
 }
 
@@ -56,21 +51,28 @@ static int xson_number_add_child(struct xson_element * parent,
 
 static void xson_number_print(struct xson_element * ele, int level, int indent,
                               int dont_pad_on_first_line) {
-    struct xson_number  *number = ele->internal;
-    char                t = *(number->end + 1);
-    
-    *(number->end + 1) = 0;
+    struct xson_number  *number = &ele->u.number;
+
     XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent),
-                       "%s", number->start);
-    *(number->end + 1) = t;
+                       "%.*s", (int)(number->end + 1 - number->start),
+                       number->start);
+}
+
+static int xson_number_freeze(struct xson_element * ele) {
+    return XSON_RESULT_SUCCESS;
+}
+
+static void xson_number_destroy(struct xson_context * ctx,
+                                struct xson_element * ele) {
 }
 
 struct xson_ele_operations number_ops =  {
     xson_number_initialize,
-    xson_number_destroy,
     xson_number_get_child,
     xson_number_add_child,
-    xson_number_print
+    xson_number_print,
+    xson_number_freeze,
+    xson_number_destroy
 };
 
 
@@ -24,145 +24,247 @@
 #include "xson/types.h"
 #include "xson/parser.h"
 
-static int xson_object_initialize(struct xson_element * e,
+static int xson_object_initialize(struct xson_context * ctx,
+                                  struct xson_element * e,
                                   struct xson_lex_element * lex) {
     struct xson_object * obj;
     
-    if ((e->internal = xson_malloc(&e->ctx->pool,
+    if ((e->u.object = xson_malloc(&ctx->pool,
                                    sizeof(struct xson_object))) == NULL) {
         return XSON_RESULT_OOM;
     }
     
-    obj = (struct xson_object *)e->internal;
+    obj = e->u.object;
+    obj->ctx = ctx;
     
-    if ((obj->pairs = malloc(sizeof(struct xson_element *) *
-                             XSON_OBJECT_INIT_PAIRS_SIZE)) == NULL) {
+    if ((obj->keys = xson_malloc(&ctx->pool, sizeof(struct xson_key_span) *
+                                 XSON_OBJECT_INIT_PAIRS_SIZE)) == NULL ||
+        (obj->values = xson_malloc(&ctx->pool, sizeof(struct xson_element *) *
+                                   XSON_OBJECT_INIT_PAIRS_SIZE)) == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (xson_pair_ht_init(&obj->ht) == XSON_RESULT_OOM) {
-        free(obj->pairs);
+    if (xson_pair_ht_init(&obj->ht, &ctx->pool) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
+    /* the filter of the document if any, see xson_enable_bloom_filters() */
+    obj->ht.bloom = ctx->bloom;
     obj->idx = 0;
     obj->size = XSON_OBJECT_INIT_PAIRS_SIZE;
     return XSON_RESULT_SUCCESS;
 }
 
-static void xson_object_destroy(struct xson_element * ele) {
-    int                 i;
-    struct xson_object  *obj = ele->internal;
-
-    for (i = 0; i < obj->idx; ++i) {
-        obj->pairs[i]->ops->destroy(obj->pairs[i]);
-    }
-    xson_pair_ht_free(&obj->ht);
-    free(obj->pairs);
-}
-
 static struct xson_element *
-xson_object_get_child(struct xson_element * ele, const char * expr) {
+xson_object_get_child(struct xson_element * ele, const char * expr,
+                      size_t len) {
     assert(ele != NULL);
-    assert(ele->internal != NULL);
+    assert(ele->u.object != NULL);
     struct xson_object  *obj;
     struct xson_element *array_elt;
-    int                  is_array;
-    char                *array_name;
+    size_t               keylen;
+    int                  i, idx;
     
-    if (ele == NULL || ele->internal == NULL)
+    if (ele == NULL || ele->u.object == NULL)
         return XSON_EXPR_NULL;
-    obj = ele->internal;
-    is_array = xson_is_array_expression(expr);
+    obj = ele->u.object;
 
-    if (is_array) {
-        /* extract key from things like 'key[idx]' */
-
-        array_name = malloc(strlen(expr));
-        
-        if (array_name == NULL)
-            return XSON_EXPR_OOM;
-        
-        strcpy(array_name, expr);
-        *strchr(array_name, '[') = '\0';
-        
-        array_elt = xson_object_get_pairval(obj, array_name);
-
-        free(array_name);
+    if (xson_parse_array_expression(expr, len, &keylen, &idx) && keylen > 0) {
+        /* the key of things like 'key[idx]' */
+        i = xson_pair_ht_retrieve(&obj->ht, obj->keys, expr, keylen,
+                                  xson_pair_ht_hash(expr, keylen));
+        array_elt = i < 0 ? NULL : obj->values[i];
 
         if (!XSON_GOOD_ELEMENT(array_elt))
             return array_elt;
         else if (array_elt->type != ELE_TYPE_ARRAY)
             return XSON_EXPR_TYPE_MISMATCH;
         else
-            return array_elt->ops->get_child(array_elt, expr);
+            return XSON_OPS(array_elt)->get_child(array_elt, expr, len);
     } else {
-        return xson_object_get_pairval(obj, expr);
+        i = xson_pair_ht_retrieve(&obj->ht, obj->keys, expr, len,
+                                  xson_pair_ht_hash(expr, len));
+        return i < 0 ? NULL : obj->values[i];
     }
     
 }
 
 static int xson_object_add_child(struct xson_element * parent,
                                  struct xson_element * child) {
-    int                 ret;
-    struct xson_object  *obj = (struct xson_object *)parent->internal;
-    if (child->type != ELE_TYPE_PAIR) {
-        printf("Child type for object element must be pair.\n");
-        return XSON_RESULT_INVALID_JSON;
-    }
-    
-    ret = xson_pair_ht_insert_replace(&obj->ht,
-                                      (struct xson_pair *)child->internal);
-    if (ret != XSON_RESULT_SUCCESS) {
-        assert(0);
-        return ret;
-    }
-    if (obj->idx >= obj->size) {
-        if (xson_buffer_grow((void **)&obj->pairs,
-            &obj->size, obj->idx,
-            sizeof(struct xson_element *)) == -1) {
-            assert(0);
-            return XSON_RESULT_OOM;
-        }
-    }
-    obj->pairs[obj->idx++] = child;
-    child->parent = parent;
-    return XSON_RESULT_SUCCESS;;
+    printf("Children of object element come with their keys, "
+           "see xson_object_add_member().\n");
+    return XSON_RESULT_INVALID_JSON;
 }
 
 static void xson_object_print(struct xson_element * ele, int level, int indent,
                               int dont_pad_on_first_line) {
     int                 i;
-    struct xson_object  *obj = ele->internal;
+    struct xson_object  *obj = ele->u.object;
     XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent), "{\n");
     for (i = 0; i < obj->idx; ++i) {
         if (i)XSON_PADDING_PRINT(0, ",\n");
-        obj->pairs[i]->ops->print(obj->pairs[i], level + 1, indent, 0);
+        XSON_PADDING_PRINT((level + 1) * indent, "\"%.*s\":",
+                           (int)obj->keys[i].len, obj->keys[i].start);
+        XSON_OPS(obj->values[i])->print(obj->values[i], level + 1, indent, 1);
         if (i == obj->idx - 1)XSON_PADDING_PRINT(0, "\n");
     }
     XSON_PADDING_PRINT(level * indent, "}");
 }
 
+static int xson_object_freeze(struct xson_element * ele) {
+    int                 i, ret;
+    struct xson_object  *obj = ele->u.object;
+
+    if ((ret = xson_pair_ht_freeze(&obj->ht, obj->keys)) != XSON_RESULT_SUCCESS)
+        return ret;
+    for (i = 0; i < obj->idx; ++i) {
+        ret = XSON_OPS(obj->values[i])->freeze(obj->values[i]);
+        if (ret != XSON_RESULT_SUCCESS)
+            return ret;
+    }
+    return XSON_RESULT_SUCCESS;
+}
+
+static void xson_object_destroy(struct xson_context * ctx,
+                                struct xson_element * ele) {
+    int                 i;
+    struct xson_object  *obj = ele->u.object;
+
+    for (i = 0; i < obj->idx; ++i)
+        xson_element_destroy(ctx, obj->values[i]);
+    xmpool_free(&ctx->pool, obj->keys,
+                obj->size * sizeof(struct xson_key_span));
+    xmpool_free(&ctx->pool, obj->values,
+                obj->size * sizeof(struct xson_element *));
+    xmpool_free(&ctx->pool, obj, sizeof(struct xson_object));
+}
+
 struct xson_ele_operations object_ops = {
     xson_object_initialize,
-    xson_object_destroy,
     xson_object_get_child,
     xson_object_add_child,
-    xson_object_print
+    xson_object_print,
+    xson_object_freeze,
+    xson_object_destroy
 };
 
+int xson_object_add_member(struct xson_object * obj, char * key, unsigned len,
+                           unsigned hash, struct xson_element * value) {
+    int                 size;
+    struct xmpool_t     *pool;
+    assert(obj != NULL);
+    assert(value != NULL);
+
+    pool = &obj->ctx->pool;
+    if (obj->idx >= obj->size) {
+        size = obj->size;
+        if (xson_pool_buffer_grow(pool, (void **)&obj->keys, &size, obj->idx,
+                                  sizeof(struct xson_key_span)) == XSON_RESULT_OOM ||
+            xson_pool_buffer_grow(pool, (void **)&obj->values, &obj->size,
+                                  obj->idx, sizeof(struct xson_element *))
+                == XSON_RESULT_OOM) {
+            return XSON_RESULT_OOM;
+        }
+    }
+    obj->keys[obj->idx].start = key;
+    obj->keys[obj->idx].len = len;
+    obj->keys[obj->idx].hash = hash;
+    obj->values[obj->idx] = value;
+
+    /* fails if the document is frozen, before the member is counted */
+    if ((size = xson_pair_ht_insert(&obj->ht, obj->keys, obj->idx)) !=
+        XSON_RESULT_SUCCESS)
+        return size;
+    ++obj->idx;
+    ++obj->ctx->generation;
+    return XSON_RESULT_SUCCESS;
+}
+
 /*
-* Get the pair to which @key is mapped.
-* Return: a pointer to that value element, NULL if the object
-*         contains no mapping for @key.
+* Return: the index of the member @key is mapped to, -1 if there is none.
 */
+static int xson_object_find(struct xson_object * obj, const char * key) {
+    size_t len = strlen(key);
+
+    return xson_pair_ht_retrieve(&obj->ht, obj->keys, key, len,
+                                 xson_pair_ht_hash(key, len));
+}
+
+/*
+* Fill @out with the view of the member @i, see xson_object_get_pair_into().
+*/
+static void xson_object_pair_fill(struct xson_object * obj, int i,
+                                  struct xson_pair * out) {
+    struct xson_key_span    *span = &obj->keys[i];
+
+    out->key.start = span->start;
+    out->key.end = span->start + span->len - 1;
+    out->value = obj->values[i];
+    out->hash = span->hash;
+}
+
+int xson_object_get_pair_into(struct xson_object * obj, const char * key,
+                              struct xson_pair * out) {
+    int i;
+    assert(obj != NULL);
+    assert(key != NULL);
+    assert(out != NULL);
+
+    if (obj == NULL || key == NULL || out == NULL)
+        return XSON_RESULT_ERROR;
+    if ((i = xson_object_find(obj, key)) < 0)
+        return XSON_RESULT_KEY_NOT_EXIST;
+
+    xson_object_pair_fill(obj, i, out);
+    return XSON_RESULT_SUCCESS;
+}
+
 struct xson_pair*
 xson_object_get_pair(struct xson_object * obj, const char * key) {
+    static __thread struct xson_pair    view;
+
+    if (xson_object_get_pair_into(obj, key, &view) != XSON_RESULT_SUCCESS)
+        return NULL;
+
+    return &view;
+}
+
+struct xson_pair*
+xson_object_get_pair_n(struct xson_object * obj, const char * key,
+                       size_t len) {
+    static __thread struct xson_pair    view;
+    int                                 i;
     assert(obj != NULL);
     assert(key != NULL);
 
-    if (obj == NULL || key == NULL)
+    if (obj == NULL || key == NULL ||
+        (i = xson_pair_ht_retrieve(&obj->ht, obj->keys, key, len,
+                                   xson_pair_ht_hash(key, len))) < 0)
         return NULL;
 
-    return xson_pair_ht_retrieve(&obj->ht, key);
+    xson_object_pair_fill(obj, i, &view);
+    return &view;
+}
+
+xson_key_t xson_key_make(const char * key, size_t len) {
+    xson_key_t  k;
+    assert(key != NULL);
+
+    k.start = (char *)key;
+    k.len = len;
+    k.hash = xson_pair_ht_hash(key, len);
+    return k;
+}
+
+struct xson_element*
+xson_object_get_by_key(struct xson_object * obj, xson_key_t key) {
+    int i;
+    assert(obj != NULL);
+
+    if (obj == NULL ||
+        (i = xson_pair_ht_retrieve(&obj->ht, obj->keys, key.start, key.len,
+                                   key.hash)) < 0)
+        return NULL;
+
+    return obj->values[i];
 }
 
 /*
@@ -172,12 +274,40 @@ xson_object_get_pair(struct xson_object * obj, const char * key) {
 */
 struct xson_element*
 xson_object_get_pairval(struct xson_object * obj, const char * key) {
-    struct xson_pair * pair = xson_object_get_pair(obj, key);
+    int i;
+    assert(obj != NULL);
+    assert(key != NULL);
 
-    if (pair == NULL)
+    if (obj == NULL || key == NULL || (i = xson_object_find(obj, key)) < 0)
         return NULL;
 
-    return pair->value;
+    return obj->values[i];
+}
+
+int xson_object_remove_pair(struct xson_object * obj, const char * key) {
+    int                 i;
+    assert(obj != NULL);
+    assert(key != NULL);
+
+    if (obj == NULL || key == NULL)
+        return XSON_RESULT_ERROR;
+    if (obj->ctx->frozen)
+        return XSON_RESULT_OP_NOTSUPPORTED;
+    if ((i = xson_object_find(obj, key)) < 0)
+        return XSON_RESULT_KEY_NOT_EXIST;
+
+    if (xson_pair_ht_delete(&obj->ht, obj->keys, obj->idx, i) !=
+        XSON_RESULT_SUCCESS)
+        return XSON_RESULT_ERROR;
+    xson_element_destroy(obj->ctx, obj->values[i]);
+    memmove(&obj->keys[i], &obj->keys[i + 1],
+            (obj->idx - i - 1) * sizeof(struct xson_key_span));
+    memmove(&obj->values[i], &obj->values[i + 1],
+            (obj->idx - i - 1) * sizeof(struct xson_element *));
+    --obj->idx;
+    ++obj->ctx->generation;
+
+    return XSON_RESULT_SUCCESS;
 }
 
 inline int xson_object_get_size(struct xson_object *obj){
@@ -188,3 +318,27 @@ inline int xson_object_get_size(struct xson_object *obj){
 
     return obj->idx;
 }
+
+void xson_object_iter_init(struct xson_object_iter * it, struct xson_object * obj) {
+    assert(it != NULL);
+    assert(obj != NULL);
+
+    it->obj = obj;
+    it->idx = 0;
+}
+
+int xson_object_iter_next(struct xson_object_iter * it, const char ** key,
+                          size_t * keylen, struct xson_element ** val) {
+    struct xson_object  *obj = it->obj;
+
+    if (obj == NULL || it->idx >= obj->idx)
+        return 0;
+    if (key)
+        *key = obj->keys[it->idx].start;
+    if (keylen)
+        *keylen = obj->keys[it->idx].len;
+    if (val)
+        *val = obj->values[it->idx];
+    ++it->idx;
+    return 1;
+}
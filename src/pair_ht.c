@@ -23,7 +23,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "xson/list.h"
 #include "xson/types.h"
 #include "xson/common.h"
 #include "xson/pair_ht.h"
@@ -38,29 +37,42 @@ static const int xson_pair_ht_primes[] =  {
             };
 static const int xson_pair_ht_nprimes = sizeof(xson_pair_ht_primes) / sizeof(int);
 
-static int xson_pair_ht_cmp(struct xson_pair * p1, const char * key2) {
-    int                 ret;
-    struct xson_string  *string = p1->key->internal;
-    char                *key1 = string->start;
-    int                 len = string->end - string->start + 1;
+/* the 2 bits of a key hash in a filter */
+#define XSON_KEY_BLOOM_BIT1(hash) ((hash) * 0x9e3779b1u)
+#define XSON_KEY_BLOOM_BIT2(hash) (((hash) * 0x85ebca6bu) ^ ((hash) >> 15))
+#define XSON_KEY_BLOOM_SET(bloom, bit) \
+    ((bloom)->bits[((bit) & (bloom)->mask) >> 5] |= 1u << ((bit) & 31))
+#define XSON_KEY_BLOOM_ISSET(bloom, bit) \
+    ((bloom)->bits[((bit) & (bloom)->mask) >> 5] & (1u << ((bit) & 31)))
+
+static void xson_key_bloom_add(struct xson_key_bloom * bloom, unsigned hash) {
+    XSON_KEY_BLOOM_SET(bloom, XSON_KEY_BLOOM_BIT1(hash));
+    XSON_KEY_BLOOM_SET(bloom, XSON_KEY_BLOOM_BIT2(hash));
+}
 
-    ret = strncmp(key1, key2, len);
+/*
+* Return: 0 if no key with this hash was added to the filter.
+*/
+static inline int xson_key_bloom_test(const struct xson_key_bloom * bloom,
+                                      unsigned hash) {
+    return XSON_KEY_BLOOM_ISSET(bloom, XSON_KEY_BLOOM_BIT1(hash)) &&
+           XSON_KEY_BLOOM_ISSET(bloom, XSON_KEY_BLOOM_BIT2(hash));
+}
 
-    return ret;
+static int xson_pair_ht_key_eq(struct xson_key_span * k,
+                               const char * key, size_t len) {
+    return k->len == len && memcmp(k->start, key, len) == 0;
 }
 
-inline unsigned xson_pair_ht_hash_by_pair(struct xson_pair * p) {
-    char                *cp, *end;
-    unsigned            hash = 0;
-    struct xson_string  *string = p->key->internal;
+inline unsigned xson_pair_ht_hash(const char * key, size_t len) {
+    const char  *end = key + len;
+    unsigned    hash = 0;
 
-    for (cp = string->start, end = string->end + 1;
-        cp < end;
-        ++cp) {
-        hash = hash * 131 + *cp;
+    while (key < end) {
+        hash = hash * 131 + *key++;
     }
 
-    return hash; 
+    return hash;
 }
 
 inline unsigned xson_pair_ht_hash_by_key(const char * key) {
@@ -73,52 +85,89 @@ inline unsigned xson_pair_ht_hash_by_key(const char * key) {
 
     return hash; 
 }
+
+static int * xson_pair_ht_alloc_table(struct xson_pair_ht * ht, int len) {
+    int i, *table;
+
+    if ((table = xson_malloc(ht->pool, len * sizeof(int))) == NULL) {
+        printf("xson parser: failed to malloc.");
+        return NULL;
+    }
+    for (i = 0; i < len; ++i) {
+        table[i] = XSON_PAIR_HT_END;
+    }
+    return table;
+}
+
+/*
+* Return: the head of the chain @hash belongs to, in the old table
+*         if its bucket there has not been moved yet.
+*/
+static int * xson_pair_ht_head(struct xson_pair_ht * ht, unsigned hash) {
+    int h;
+
+    if (ht->old_table && (h = hash % ht->old_len) >= ht->rehash_idx)
+        return &ht->old_table[h];
+    return &ht->table[hash % ht->len];
+}
+
+/*
+* Move up to @n buckets of the old table to the new one.
+* @ht: the hash table being resized.
+* @keys: the keys of the members.
+* @n: the number of buckets to move.
+*/
+static void xson_pair_ht_rehash_step(struct xson_pair_ht * ht,
+                                     struct xson_key_span * keys, int n) {
+    int i, next, *head;
+
+    while (ht->old_table && n-- > 0) {
+        for (i = ht->old_table[ht->rehash_idx]; i != XSON_PAIR_HT_END; i = next) {
+            next = ht->next[i];
+            head = &ht->table[keys[i].hash % ht->len];
+            ht->next[i] = *head;
+            *head = i;
+        }
+        ht->old_table[ht->rehash_idx] = XSON_PAIR_HT_END;
+        if (++ht->rehash_idx >= ht->old_len) {
+            /* the old slots are left to the pool */
+            ht->old_table = NULL;
+            ht->old_len = 0;
+            ht->rehash_idx = 0;
+        }
+    }
+}
+
 /*
 * Expand the size of the hash table to @size.
+* The entries are moved to the new slots incrementally by
+* the following insertions, see xson_pair_ht_rehash_step().
 * @ht: the hash table to expand
+* @keys: the keys of the members.
 * @size: the size we expand to
 */
-static int xson_pair_ht_expand(struct xson_pair_ht * ht, int size) {
-    int                 new_len, new_idx, i;
-    struct xson_pair    *entry;
-    struct list_head    *new_table, *p, *q, *head;
+static int xson_pair_ht_expand(struct xson_pair_ht * ht,
+                               struct xson_key_span * keys, int size) {
+    int new_len, new_idx, *new_table;
     
-    unsigned h;
     new_len = ht->len;
     new_idx = ht->p_index;
-    while ((new_len * LOAD_FACTOR) < size && new_idx < xson_pair_ht_nprimes) {
+    while ((new_len * LOAD_FACTOR) < size && new_idx + 1 < xson_pair_ht_nprimes) {
         new_len = xson_pair_ht_primes[++new_idx];
     }
 
-    if ((new_table = malloc(new_len * sizeof(struct list_head))) == NULL) {
-        printf("xson parser: failed to malloc.");
+    if ((new_table = xson_pair_ht_alloc_table(ht, new_len)) == NULL) {
         return XSON_RESULT_OOM;
     }
 
-    for (i = 0; i < new_len; ++i) {
-        INIT_LIST_HEAD(&new_table[i]);
-    }
-
-    /*
-    * Rehash and move all xson_pair to new_table.
-    */
-    for (i = 0; i < ht->len; ++i) {
-        head = &(ht->table[i]);
-        if (!list_empty(head)) {
-            p = head->next;
-            while (p != head) {
-                q = p->next;
-                entry = list_entry(p, struct xson_pair, hash_link);
-                list_del(p);
-                h = xson_pair_ht_hash_by_pair(entry) % new_len;
-                list_add_tail(&entry->hash_link, &new_table[h]);
-                p = q;
-            }
-        }
+    /* finish the previous resizing before starting a new one */
+    xson_pair_ht_rehash_step(ht, keys, ht->old_len);
+    if (ht->table) {
+        ht->old_table = ht->table;
+        ht->old_len = ht->len;
+        ht->rehash_idx = 0;
     }
 
-    free(ht->table);
-
     ht->p_index = new_idx;
     ht->table = new_table;
     ht->len = new_len;
@@ -126,121 +175,431 @@ static int xson_pair_ht_expand(struct xson_pair_ht * ht, int size) {
     return XSON_RESULT_SUCCESS;
 }
 
-inline int xson_pair_ht_init(struct xson_pair_ht * ht) {
-    int i, idx;
-
-    idx = 0;
+inline int xson_pair_ht_init(struct xson_pair_ht * ht, struct xmpool_t * pool) {
+    ht->pool = pool;
     ht->p_index = 0;
     ht->n_entries = 0;
-    ht->len = xson_pair_ht_primes[idx];
+    ht->len = xson_pair_ht_primes[ht->p_index];
+    ht->table = NULL;
+    ht->next = NULL;
+    ht->next_len = 0;
+    ht->old_table = NULL;
+    ht->old_len = 0;
+    ht->rehash_idx = 0;
+    ht->slots = NULL;
+    ht->n_slots = 0;
+    ht->seeds = NULL;
+    ht->bloom = NULL;
 
-    ht->table = malloc(ht->len * sizeof(struct list_head));
-    if (ht->table == NULL) {
-        return XSON_RESULT_OOM;
+    return XSON_RESULT_SUCCESS;
+}
+
+/*
+* Make room for the chain link of the member @idx.
+*/
+static int xson_pair_ht_grow_links(struct xson_pair_ht * ht, int idx) {
+    if (idx < ht->next_len)
+        return XSON_RESULT_SUCCESS;
+    if (ht->next == NULL) {
+        ht->next_len = idx < XSON_PAIR_HT_INIT_LINKS ?
+                       XSON_PAIR_HT_INIT_LINKS : idx + 1;
+        ht->next = xson_malloc(ht->pool, ht->next_len * sizeof(int));
+        return ht->next ? XSON_RESULT_SUCCESS : XSON_RESULT_OOM;
     }
-    for (i = 0; i < ht->len; ++i) {
-        INIT_LIST_HEAD(&ht->table[i]);
+    return xson_pool_buffer_grow(ht->pool, (void **)&ht->next,
+                                 &ht->next_len, idx, sizeof(int));
+}
+
+int xson_pair_ht_reserve(struct xson_pair_ht * ht,
+                         struct xson_key_span * keys, int size) {
+    if (ht->slots)
+        return XSON_RESULT_OP_NOTSUPPORTED;
+
+    if (size > 0 && xson_pair_ht_grow_links(ht, size - 1) == XSON_RESULT_OOM)
+        return XSON_RESULT_OOM;
+
+    if (size <= (ht->len * LOAD_FACTOR))
+        return XSON_RESULT_SUCCESS;
+
+    if (ht->table == NULL) {
+        /* nothing allocated yet, just pick the size */
+        while ((ht->len * LOAD_FACTOR) < size &&
+               ht->p_index + 1 < xson_pair_ht_nprimes) {
+            ht->len = xson_pair_ht_primes[++ht->p_index];
+        }
+        return XSON_RESULT_SUCCESS;
     }
-    return XSON_RESULT_SUCCESS;
+
+    return xson_pair_ht_expand(ht, keys, size);
 }
 
-inline int
-xson_pair_ht_insert(struct xson_pair_ht * ht, struct xson_pair * new) {
-    unsigned h;
+static int xson_pair_ht_lookup(struct xson_pair_ht * ht,
+                               struct xson_key_span * keys,
+                               const char * key, size_t len, unsigned hash) {
+    int i;
 
-    if (new->hash_link.prev || new->hash_link.next) {
-        /*
-        * This xson_pair is already in the hash table.
-        * Assume every xson_pair only can be in one reactor.
-        */
-        return XSON_RESULT_ERROR;
+    if (ht->table == NULL)
+        return -1;
+    for (i = *xson_pair_ht_head(ht, hash); i != XSON_PAIR_HT_END; i = ht->next[i]) {
+        if (keys[i].hash == hash && xson_pair_ht_key_eq(&keys[i], key, len))
+            return i;
     }
+    return -1;
+}
+
+int xson_pair_ht_insert(struct xson_pair_ht * ht,
+                        struct xson_key_span * keys, int idx) {
+    struct xson_key_span    *k = &keys[idx];
+    int                     *head;
+
+    if (ht->slots)
+        return XSON_RESULT_OP_NOTSUPPORTED;
 
-    /* expand the hash table if nessesary */
-    if (ht->n_entries >= (ht->len * LOAD_FACTOR) &&
-        xson_pair_ht_expand(ht, ht->n_entries + 1) == XSON_RESULT_OOM)
+    if (xson_pair_ht_grow_links(ht, idx) == XSON_RESULT_OOM)
         return XSON_RESULT_OOM;
 
-    h = xson_pair_ht_hash_by_pair(new) % ht->len;
-    list_add_tail(&new->hash_link, &ht->table[h]);
+    /* allocate or expand the hash table if nessesary */
+    if ((ht->table == NULL || ht->n_entries >= (ht->len * LOAD_FACTOR)) &&
+        xson_pair_ht_expand(ht, keys, ht->n_entries + 1) == XSON_RESULT_OOM)
+        return XSON_RESULT_OOM;
+    xson_pair_ht_rehash_step(ht, keys, XSON_PAIR_HT_REHASH_STEP);
+
+    if (k->hash == 0)
+        k->hash = xson_pair_ht_hash(k->start, k->len);
+    if (ht->bloom)
+        xson_key_bloom_add(ht->bloom, k->hash);
+    /* the first member of a key wins the lookups */
+    if (xson_pair_ht_lookup(ht, keys, k->start, k->len, k->hash) != -1) {
+        ht->next[idx] = XSON_PAIR_HT_SHADOWED;
+        return XSON_RESULT_SUCCESS;
+    }
+    head = xson_pair_ht_head(ht, k->hash);
+    ht->next[idx] = *head;
+    *head = idx;
     ++(ht->n_entries);
     return XSON_RESULT_SUCCESS;
 }
 
-inline int
-xson_pair_ht_insert_replace(struct xson_pair_ht * ht, struct xson_pair * new) {
-    unsigned h;
+int xson_pair_ht_delete(struct xson_pair_ht * ht,
+                        struct xson_key_span * keys, int n, int idx) {
+    struct xson_key_span    *k = &keys[idx];
+    int                     i, *p;
+
+    if (ht->slots)
+        return XSON_RESULT_OP_NOTSUPPORTED;
+
+    if (ht->next[idx] != XSON_PAIR_HT_SHADOWED) {
+        for (p = xson_pair_ht_head(ht, k->hash); *p != idx; p = &ht->next[*p])
+            ;
+        *p = ht->next[idx];
+        --(ht->n_entries);
+        /* the next member with the same key comes out of the shadow */
+        for (i = idx + 1; i < n; ++i) {
+            if (ht->next[i] == XSON_PAIR_HT_SHADOWED &&
+                keys[i].hash == k->hash &&
+                xson_pair_ht_key_eq(&keys[i], k->start, k->len)) {
+                p = xson_pair_ht_head(ht, k->hash);
+                ht->next[i] = *p;
+                *p = i;
+                ++(ht->n_entries);
+                break;
+            }
+        }
+    }
+
+    /* renumber the members after @idx */
+    for (i = 0; i < ht->len; ++i)
+        if (ht->table[i] > idx)
+            --ht->table[i];
+    for (i = 0; ht->old_table && i < ht->old_len; ++i)
+        if (ht->old_table[i] > idx)
+            --ht->old_table[i];
+    for (i = 0; i < n; ++i)
+        if (ht->next[i] > idx)
+            --ht->next[i];
+    memmove(&ht->next[idx], &ht->next[idx + 1], (n - idx - 1) * sizeof(int));
+    return XSON_RESULT_SUCCESS;
+}
+
+/*
+* Mix @hash with @seed of a bucket of the perfect hash.
+*/
+static inline unsigned xson_pair_ht_mix(unsigned hash, unsigned seed) {
+    hash ^= seed * 0x9e3779b9u;
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
 
-    if (new->hash_link.prev || new->hash_link.next) {
-        /*
-        * This xson_pair is not in the hash table.
-        * Assume every xson_pair only can be in one reactor.
-        */
-        return XSON_RESULT_ERROR;
+static int
+xson_pair_ht_frozen_retrieve(struct xson_pair_ht * ht,
+                             struct xson_key_span * keys,
+                             const char * key, size_t len, unsigned hash) {
+    int                         lo, hi, mid;
+    struct xson_pair_ht_slot    *slot;
+
+    if (ht->seeds) {
+        slot = &ht->slots[xson_pair_ht_mix(hash, ht->seeds[hash % ht->len]) %
+                          ht->n_slots];
+        if (slot->idx >= 0 && slot->hash == hash &&
+            xson_pair_ht_key_eq(&keys[slot->idx], key, len))
+            return slot->idx;
+        return -1;
     }
 
-    /* expand the hash table if nessesary */
-    if (ht->n_entries >= (ht->len * LOAD_FACTOR) &&
-        xson_pair_ht_expand(ht, ht->n_entries + 1) == XSON_RESULT_OOM)
-        return XSON_RESULT_OOM;
+    /* lower bound of @hash in the sorted slots */
+    lo = 0;
+    hi = ht->n_entries;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (ht->slots[mid].hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (; lo < ht->n_entries && ht->slots[lo].hash == hash; ++lo) {
+        if (xson_pair_ht_key_eq(&keys[ht->slots[lo].idx], key, len))
+            return ht->slots[lo].idx;
+    }
+    return -1;
+}
 
-    /* rehash the key */
-    h = xson_pair_ht_hash_by_pair(new) % ht->len;
-    list_add_tail(&new->hash_link, &ht->table[h]);
-    ++(ht->n_entries);
-    return XSON_RESULT_SUCCESS;
+inline int xson_pair_ht_retrieve(struct xson_pair_ht * ht,
+                                 struct xson_key_span * keys,
+                                 const char * key, size_t len, unsigned hash) {
+    if (ht->n_entries == 0)
+        return -1;
+    if (ht->bloom && !xson_key_bloom_test(ht->bloom, hash))
+        return -1;
+    if (ht->slots)
+        return xson_pair_ht_frozen_retrieve(ht, keys, key, len, hash);
+    return xson_pair_ht_lookup(ht, keys, key, len, hash);
 }
 
-inline void
-xson_pair_ht_delete_by_key(struct xson_pair_ht * ht, const char * key) {
-    unsigned            h;
-    struct list_head    *p;
-    
-    h = xson_pair_ht_hash_by_key(key) % ht->len;
-    
+static int xson_pair_ht_slot_cmp(const void * a, const void * b) {
+    const struct xson_pair_ht_slot *s1 = a, *s2 = b;
+
+    if (s1->hash != s2->hash)
+        return s1->hash < s2->hash ? -1 : 1;
+    return s1->idx - s2->idx;
+}
+
+/*
+* Place every slot of @sorted into new slots by a perfect hash: keys are
+* grouped into @ht->len buckets, then starting from the largest bucket
+* a seed is searched for each bucket which sends all of its keys to free
+* slots. There are more slots than keys, see XSON_PAIR_HT_MPH_HEADROOM,
+* otherwise the last buckets are left with as many free slots as keys
+* and hardly any seed fits them.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_ERROR if no seed works for some bucket.
+*/
+static int xson_pair_ht_build_mph(struct xson_pair_ht * ht,
+                                  struct xson_pair_ht_slot * sorted, int n) {
+    int             nb, m, i, j, k, b, size, max_size;
+    unsigned        seed, s;
+    struct xson_pair_ht_slot *slots;
+    int             *count = NULL, *start = NULL, *order = NULL, *bucket_of = NULL;
+    unsigned        *pos = NULL;
+    char            *taken = NULL;
+    int             ret = XSON_RESULT_OOM;
+    const struct xmpool_allocator_t *a = ht->pool->allocator;
+
+    nb = (n + XSON_PAIR_HT_MPH_LAMBDA - 1) / XSON_PAIR_HT_MPH_LAMBDA;
+    m = n + n / XSON_PAIR_HT_MPH_HEADROOM + 1;
+
+    slots = xson_malloc(ht->pool, m * sizeof(struct xson_pair_ht_slot));
+    ht->seeds = xson_malloc(ht->pool, nb * sizeof(unsigned short));
+    count = XM_ALLOC(a, (nb + 1) * sizeof(int));
+    start = XM_ALLOC(a, (nb + 1) * sizeof(int));
+    order = XM_ALLOC(a, n * sizeof(int));
+    bucket_of = XM_ALLOC(a, nb * sizeof(int));
+    pos = XM_ALLOC(a, n * sizeof(unsigned));
+    taken = XM_ALLOC(a, m);
+    if (slots == NULL || ht->seeds == NULL || count == NULL || start == NULL ||
+        order == NULL || bucket_of == NULL || pos == NULL || taken == NULL)
+        goto out;
+    memset(ht->seeds, 0, nb * sizeof(unsigned short));
+    memset(count, 0, (nb + 1) * sizeof(int));
+    memset(taken, 0, m);
+    for (s = 0; s < (unsigned)m; ++s) {
+        slots[s].hash = 0;
+        slots[s].idx = -1;
+    }
 
-    list_for_each(p, &ht->table[h]) {
-        struct xson_pair * entry = list_entry(p, struct xson_pair, hash_link);
-        if (xson_pair_ht_cmp(entry,key) == 0) {
-            list_del(p);
-            --(ht->n_entries);
-            return;
+    /* group the keys by bucket */
+    for (i = 0; i < n; ++i)
+        ++count[sorted[i].hash % nb];
+    for (b = 0, start[0] = 0; b < nb; ++b)
+        start[b + 1] = start[b] + count[b];
+    for (b = 0; b < nb; ++b)
+        count[b] = start[b];
+    for (i = 0; i < n; ++i)
+        order[count[sorted[i].hash % nb]++] = i;
+
+    /* visit the buckets from the largest one */
+    for (max_size = 0, b = 0; b < nb; ++b)
+        if (start[b + 1] - start[b] > max_size)
+            max_size = start[b + 1] - start[b];
+    for (k = 0, size = max_size; size > 0; --size)
+        for (b = 0; b < nb; ++b)
+            if (start[b + 1] - start[b] == size)
+                bucket_of[k++] = b;
+
+    ret = XSON_RESULT_ERROR;
+    for (i = 0; i < k; ++i) {
+        b = bucket_of[i];
+        size = start[b + 1] - start[b];
+        for (seed = 0; seed <= 0xffff; ++seed) {
+            for (j = 0; j < size; ++j) {
+                s = xson_pair_ht_mix(sorted[order[start[b] + j]].hash, seed) % m;
+                if (taken[s])
+                    break;
+                taken[s] = 1;
+                pos[j] = s;
+            }
+            if (j == size)
+                break;
+            /* undo the partial placement */
+            while (j--)
+                taken[pos[j]] = 0;
         }
+        if (seed > 0xffff)
+            goto out;
+        ht->seeds[b] = seed;
+        for (j = 0; j < size; ++j)
+            slots[pos[j]] = sorted[order[start[b] + j]];
+    }
+    /* the slots sorted by hash are not needed */
+    xmpool_free(ht->pool, ht->slots, ht->n_slots *
+                sizeof(struct xson_pair_ht_slot));
+    ht->slots = slots;
+    ht->n_slots = m;
+    ht->len = nb;
+    ret = XSON_RESULT_SUCCESS;
+out:
+    if (ret != XSON_RESULT_SUCCESS) {
+        if (ht->seeds)
+            xmpool_free(ht->pool, ht->seeds, nb * sizeof(unsigned short));
+        if (slots)
+            xmpool_free(ht->pool, slots, m * sizeof(struct xson_pair_ht_slot));
+        ht->seeds = NULL;
     }
+    if (count) XM_FREE(a, count);
+    if (start) XM_FREE(a, start);
+    if (order) XM_FREE(a, order);
+    if (bucket_of) XM_FREE(a, bucket_of);
+    if (pos) XM_FREE(a, pos);
+    if (taken) XM_FREE(a, taken);
+    return ret;
 }
 
-inline int
-xson_pair_ht_delete(struct xson_pair_ht * ht, struct xson_pair * pair) {
-    if (pair->hash_link.prev == NULL || pair->hash_link.next == NULL) {
-        /*
-        * This xson_pair is not in the hash table.
-        * Assume every xson_pair only can be in one reactor.
-        */
+int xson_pair_ht_freeze(struct xson_pair_ht * ht, struct xson_key_span * keys) {
+    int                         i, j, n, collision;
+    struct xson_pair_ht_slot    *sorted, *slots;
+
+    if (ht->slots)
         return XSON_RESULT_SUCCESS;
+
+    if ((sorted = XM_ALLOC(ht->pool->allocator, (ht->n_entries + 1) *
+                           sizeof(struct xson_pair_ht_slot))) == NULL)
+        return XSON_RESULT_OOM;
+    if ((slots = xson_malloc(ht->pool, (ht->n_entries + 1) *
+                             sizeof(struct xson_pair_ht_slot))) == NULL) {
+        XM_FREE(ht->pool->allocator, sorted);
+        return XSON_RESULT_OOM;
+    }
+
+    xson_pair_ht_rehash_step(ht, keys, ht->old_len);
+
+    /* shadowed members are not in the chains, every key shows up once */
+    n = 0;
+    for (i = 0; ht->table && i < ht->len; ++i) {
+        for (j = ht->table[i]; j != XSON_PAIR_HT_END; j = ht->next[j]) {
+            sorted[n].hash = keys[j].hash;
+            sorted[n].idx = j;
+            ++n;
+        }
+    }
+    qsort(sorted, n, sizeof(struct xson_pair_ht_slot), xson_pair_ht_slot_cmp);
+
+    collision = 0;
+    for (i = 1; i < n && !collision; ++i)
+        collision = sorted[i - 1].hash == sorted[i].hash;
+
+    ht->slots = slots;
+    ht->n_slots = ht->n_entries + 1;
+    if (n <= XSON_PAIR_HT_SORTED_MAX || collision ||
+        xson_pair_ht_build_mph(ht, sorted, n) != XSON_RESULT_SUCCESS) {
+        memcpy(ht->slots, sorted, n * sizeof(struct xson_pair_ht_slot));
     }
+    XM_FREE(ht->pool->allocator, sorted);
+
+    /* the chains are left to the pool */
+    ht->table = NULL;
+    ht->next = NULL;
+    ht->next_len = 0;
+    ht->n_entries = n;
 
-    list_del(&pair->hash_link);
-    --(ht->n_entries);
     return XSON_RESULT_SUCCESS;
 }
 
-inline struct xson_pair *
-xson_pair_ht_retrieve(struct xson_pair_ht * ht, const char * key) {
-    unsigned            h;
-    struct list_head    *p;
+struct xson_key_bloom * xson_key_bloom_new(struct xmpool_t * pool,
+                                           size_t n_bits) {
+    struct xson_key_bloom   *bloom;
+    size_t                  len;
+
+    /* a word at least */
+    for (len = 32; len < n_bits; len <<= 1)
+        ;
+    if ((bloom = xson_malloc(pool, sizeof(struct xson_key_bloom) +
+                             len / 8)) == NULL)
+        return NULL;
+    bloom->bits = (unsigned *)(bloom + 1);
+    bloom->mask = len - 1;
+    memset(bloom->bits, 0, len / 8);
+
+    return bloom;
+}
 
-    h =  xson_pair_ht_hash_by_key(key) % ht->len;
+size_t xson_key_bloom_memory(const struct xson_key_bloom * bloom) {
+    return XM_ALIGN(sizeof(struct xson_key_bloom) + (bloom->mask + 1) / 8,
+                    XM_ALIGNMENT);
+}
 
-    list_for_each(p, &ht->table[h]) {
-        struct xson_pair * entry = list_entry(p, struct xson_pair, hash_link);
-        if (xson_pair_ht_cmp(entry, key) == 0) {
-            return entry;
-        }
-    }
-    
-    return NULL;
+int xson_pair_ht_own_bloom(struct xson_pair_ht * ht,
+                           struct xson_key_span * keys, int n) {
+    struct xson_key_bloom   *bloom;
+    int                     i;
+
+    if ((bloom = xson_key_bloom_new(ht->pool, (size_t)n *
+                                    XSON_KEY_BLOOM_BITS_PER_KEY)) == NULL)
+        return XSON_RESULT_OOM;
+    for (i = 0; i < n; ++i)
+        xson_key_bloom_add(bloom, keys[i].hash);
+    ht->bloom = bloom;
+
+    return XSON_RESULT_SUCCESS;
 }
 
-inline void xson_pair_ht_free(struct xson_pair_ht * ht) {
-    free(ht->table);
+size_t xson_pair_ht_memory(struct xson_pair_ht * ht) {
+    size_t bytes = 0;
+
+    if (ht->slots) {
+        bytes += XM_ALIGN(ht->n_slots * sizeof(struct xson_pair_ht_slot),
+                          XM_ALIGNMENT);
+        if (ht->seeds)
+            bytes += XM_ALIGN(ht->len * sizeof(unsigned short), XM_ALIGNMENT);
+        return bytes;
+    }
+    if (ht->table)
+        bytes += XM_ALIGN(ht->len * sizeof(int), XM_ALIGNMENT);
+    if (ht->old_table)
+        bytes += XM_ALIGN(ht->old_len * sizeof(int), XM_ALIGNMENT);
+    if (ht->next)
+        bytes += XM_ALIGN(ht->next_len * sizeof(int), XM_ALIGNMENT);
+    return bytes;
 }
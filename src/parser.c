@@ -28,6 +28,7 @@
 #include "xson/parser.h"
 #include "xson/fsm_string.h"
 #include "xson/fsm_number.h"
+#include "xson/path.h"
 
 extern struct xson_ele_operations root_ops;
 extern struct xson_ele_operations object_ops;
@@ -35,85 +36,75 @@ extern struct xson_ele_operations array_ops;
 extern struct xson_ele_operations string_ops;
 extern struct xson_ele_operations number_ops;
 extern struct xson_ele_operations bool_ops;
-extern struct xson_ele_operations pair_ops;
 extern struct xson_ele_operations null_ops;
 
-static int xson_element_initialize(struct xson_context * ctx, 
-                            struct xson_element * ele,
-                            enum xson_ele_type type) {
+/* indexed by enum xson_ele_type */
+struct xson_ele_operations * const xson_ele_ops[] = {
+    &root_ops,      /* ELE_TYPE_ROOT */
+    &root_ops,      /* ELE_TYPE_VALUE */
+    &object_ops,    /* ELE_TYPE_OBJECT */
+    &array_ops,     /* ELE_TYPE_ARRAY */
+    &string_ops,    /* ELE_TYPE_STRING */
+    &number_ops,    /* ELE_TYPE_NUMBER */
+    &bool_ops,      /* ELE_TYPE_BOOL */
+    NULL,           /* ELE_TYPE_PAIR, objects store their members */
+    &null_ops       /* ELE_TYPE_NULL */
+};
+
+static void xson_element_initialize(struct xson_element * ele,
+                                    enum xson_ele_type type) {
     memset(ele, 0, sizeof(struct xson_element));
-    ele->ctx = ctx;
     ele->type = type;
-    
-    switch (type) {
-        case ELE_TYPE_ROOT:
-            ele->ops = &root_ops;
-            break;
-        case ELE_TYPE_OBJECT:
-            ele->ops = &object_ops;
-            break;
-        case ELE_TYPE_ARRAY:
-            ele->ops = &array_ops;
-            break;
-        case ELE_TYPE_STRING:
-            ele->ops = &string_ops;
-            break;
-        case ELE_TYPE_NUMBER:
-            ele->ops = &number_ops;
-            break;
-        case ELE_TYPE_BOOL:
-            ele->ops = &bool_ops;
-            break;
-        case ELE_TYPE_PAIR:
-            ele->ops = &pair_ops;
-            break;
-        case ELE_TYPE_NULL:
-            ele->ops = &null_ops;
-            break;
-        default:
-            printf("Unknown element type %d.\n", type);
-            return (-1);
-    }
-
-    return 0;
 }
 
 int xson_init(struct xson_context * ctx, const char * str) {
+    return xson_init_with_allocator(ctx, str, &xmpool_default_allocator);
+}
+
+int xson_init_with_allocator(struct xson_context * ctx, const char * str,
+                             const struct xmpool_allocator_t * allocator) {
     int len;
     assert(str != NULL);
     assert(ctx != NULL);
+    assert(allocator != NULL);
 
     len = strlen(str);
-    if ((ctx->str_buf = malloc((len + 1) * sizeof(char))) == NULL) {
+    if ((allocator != &xmpool_default_allocator || len < XSON_CTX_ARENA_MIN_LEN ||
+         xmpool_init_arena(&ctx->pool, (size_t)len * XSON_CTX_ARENA_RATIO,
+                           XM_ARENA_HUGEPAGE) == -1) &&
+        xmpool_init_with_allocator(&ctx->pool, XM_CHUNK_SIZE, allocator) == -1) {
         return (-1);
     }
-    if (xmpool_init(&ctx->pool, XM_CHUNK_SIZE) == -1) {
-        free(ctx->str_buf);
+    /* the string copy and the lex stack live in the pool as well */
+    if ((ctx->str_buf = xson_malloc(&ctx->pool,
+                                    (len + 1) * sizeof(char))) == NULL ||
+        (ctx->stack = xson_malloc(&ctx->pool, XSON_CTX_INIT_STK_LEN *
+                                  sizeof(struct xson_lex_element))) == NULL ||
+        (ctx->root = xson_malloc(&ctx->pool,
+                                 sizeof(struct xson_element))) == NULL) {
+        xmpool_destroy(&ctx->pool);
         return (-1);
     }
     strcpy(ctx->str_buf, str);
     ctx->str_len = len;
-
-    if ((ctx->root = xson_malloc(&ctx->pool,
-                                 sizeof(struct xson_element))) == NULL) {
-        free(ctx->str_buf);
+    ctx->frozen = 0;
+    ctx->generation = 0;
+    ctx->cache = NULL;
+    ctx->cache_len = 0;
+    ctx->lazy = NULL;
+    ctx->lazy_len = 0;
+    ctx->projection = NULL;
+    ctx->proj_node = -1;
+    ctx->shape = NULL;
+    ctx->bloom = NULL;
+    ctx->bloom_min = 0;
+
+    xson_element_initialize(ctx->root, ELE_TYPE_ROOT);
+    if (XSON_OPS(ctx->root)->initialize(ctx, ctx->root, NULL) == XSON_RESULT_OOM) {
         xmpool_destroy(&ctx->pool);
-        return (-1);
-    }
-    xson_element_initialize(ctx, ctx->root, ELE_TYPE_ROOT);
-    ctx->root->parent = ctx->root;
-    if (ctx->root->ops->initialize(ctx->root, NULL) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
 
-    if ((ctx->stack = malloc(XSON_CTX_INIT_STK_LEN *
-                             sizeof(struct xson_lex_element))) == NULL) {
-        free(ctx->str_buf);
-        free(ctx->root);
-        xmpool_destroy(&ctx->pool);
-        return (-1);
-    }
-
     ctx->stk_len = XSON_CTX_INIT_STK_LEN;
     ctx->stk_top = 0;
     ctx->stack[0].state = LEX_STATE_EMPTY;
@@ -131,15 +122,18 @@ int xson_init(struct xson_context * ctx, const char * str) {
 * @state: the state of the lex element.
 * @start: starting pointer to contents of this lex element.
 * @end: ending pointer to contents of this lex element.
-* @e: the xson_element associated with the lex element.
+* @e: the xson_element associated with the lex element, NULL for separators.
+* @parent: the element enclosing the lex element.
 */
 static struct xson_lex_element * xson_stack_push(struct xson_context * ctx,
                      enum xson_lex_state state,
                       char * start, char * end,
-                      struct xson_element * e) {
+                      struct xson_element * e,
+                      struct xson_element * parent) {
     if (ctx->stk_top >= ctx->stk_len &&
-        xson_buffer_grow((void **)&ctx->stack, &ctx->stk_len,
-                         ctx->stk_top, sizeof(struct xson_lex_element))
+        xson_pool_buffer_grow(&ctx->pool,
+                              (void **)&ctx->stack, &ctx->stk_len,
+                              ctx->stk_top, sizeof(struct xson_lex_element))
             == XSON_RESULT_OOM) {
         return NULL;
     }
@@ -149,6 +143,8 @@ static struct xson_lex_element * xson_stack_push(struct xson_context * ctx,
     ctx->stack[ctx->stk_top].start = start;
     ctx->stack[ctx->stk_top].end = end;
     ctx->stack[ctx->stk_top].element = e;
+    ctx->stack[ctx->stk_top].hash = 0;
+    ctx->stack[ctx->stk_top].parent = parent;
     ++ctx->stk_top;
 
     return ret;
@@ -299,12 +295,26 @@ inline static int xson_stack_top_state(struct xson_context * ctx) {
                              top_state != LEX_STATE_STRING &&\
                              top_state != LEX_STATE_ARRAY)
 
+/*
+* An object or array opened, @lex is its lex element: remember the node
+* of the enclosing element, and take the node of the key if it is the
+* value of a pair, the elements of an array share the node of the array.
+*/
+#define XSON_PROJECTION_ENTER(ctx, lex, top_state)                      \
+    do {                                                                \
+        (lex)->proj = (ctx)->proj_node;                                 \
+        if ((ctx)->proj_node >= 0 && (top_state) == LEX_STATE_COLON)    \
+            (ctx)->proj_node = xson_stack_get_top_nr((ctx), 3)->proj;   \
+    } while (0)
+
 static int
 xson_handle_open_object(struct xson_context * ctx,
                         struct xson_element ** parent, char **cp) {
     int                     top_state;
     struct xson_element     *e = NULL;
     struct xson_lex_element *lex = NULL;
+    struct xson_array       *array = NULL;
+    struct xson_object      *obj = NULL;
     
 
     top_state = xson_stack_top_state(ctx);
@@ -314,20 +324,39 @@ xson_handle_open_object(struct xson_context * ctx,
         return XSON_RESULT_OOM;
     }
 
-    xson_element_initialize(ctx, e, ELE_TYPE_OBJECT);
-    lex = xson_stack_push(ctx, LEX_STATE_LEFT_BRACE, *cp, *cp, e);
+    xson_element_initialize(e, ELE_TYPE_OBJECT);
+    lex = xson_stack_push(ctx, LEX_STATE_LEFT_BRACE, *cp, *cp, e, *parent);
     if (lex == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (e->ops->initialize(e, lex) == XSON_RESULT_OOM) {
+    XSON_PROJECTION_ENTER(ctx, lex, top_state);
+    if (XSON_OPS(e)->initialize(ctx, e, lex) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
+    lex->shape = ctx->shape;
+    ctx->shape = NULL;
+
+    /*
+    * [..., {...}, {} situation, records tend to share one shape.
+    * Not when a projection picks the members: the keys kept by the
+    * previous record do not line up with the keys of this one.
+    */
+    if ((*parent)->type == ELE_TYPE_ARRAY && ctx->proj_node < 0) {
+        array = (*parent)->u.array;
+        if (array->idx > 0 &&
+            array->array[array->idx - 1]->type == ELE_TYPE_OBJECT) {
+            obj = e->u.object;
+            ctx->shape = array->array[array->idx - 1]->u.object;
+            /* size the table for the predicted keys up front */
+            if (xson_pair_ht_reserve(&obj->ht, obj->keys, ctx->shape->idx) ==
+                XSON_RESULT_OOM)
+                return XSON_RESULT_OOM;
+        }
+    }
     
     /*  {"...": {}} situation. */
-    if ((*parent)->type != ELE_TYPE_OBJECT) {
-        e->parent = *parent;
-        (*parent)->ops->add_child(*parent, e);
-    }
+    if ((*parent)->type != ELE_TYPE_OBJECT)
+        XSON_OPS(*parent)->add_child(*parent, e);
         
     *parent = e;
 
@@ -349,18 +378,18 @@ xson_handle_open_array(struct xson_context * ctx,
         return XSON_RESULT_OOM;
     }
 
-    xson_element_initialize(ctx, e, ELE_TYPE_ARRAY);
-    lex = xson_stack_push(ctx, LEX_STATE_LEFT_SQBRACKT, *cp, *cp, e);
+    xson_element_initialize(e, ELE_TYPE_ARRAY);
+    lex = xson_stack_push(ctx, LEX_STATE_LEFT_SQBRACKT, *cp, *cp, e, *parent);
     if (lex == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (e->ops->initialize(e, lex) == XSON_RESULT_OOM) {
+    XSON_PROJECTION_ENTER(ctx, lex, top_state);
+    if (XSON_OPS(e)->initialize(ctx, e, lex) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
-    e->parent = *parent;
     /*  {"...":[]} situation. */
     if ((*parent)->type != ELE_TYPE_OBJECT)
-        (*parent)->ops->add_child(*parent, e);
+        XSON_OPS(*parent)->add_child(*parent, e);
     *parent = e;
 
     return XSON_RESULT_SUCCESS;
@@ -370,13 +399,11 @@ static int
 xson_handle_pair(struct xson_context * ctx,
                  struct xson_element ** parent) {
     int                     top_state;
-    struct xson_element     *key = NULL;
     struct xson_element     *value = NULL;
-    struct xson_element     *pair = NULL;
-    struct xson_lex_element *lex = NULL;
     struct xson_lex_element *key_lex = NULL;
     struct xson_lex_element *value_lex = NULL;
-    struct xson_pair        *pair_internal = NULL;
+    char                    *key, *end;
+    unsigned                len, hash;
     
 
     value_lex = xson_stack_pop(ctx);
@@ -387,63 +414,200 @@ xson_handle_pair(struct xson_context * ctx,
     if (XSON_PAIR_COND || (*parent)->type != ELE_TYPE_OBJECT)
         return XSON_RESULT_INVALID_JSON;
 
-    key = key_lex->element;
-    value = value_lex->element;
-    if (key->type != ELE_TYPE_STRING) {
+    /* keys are not materialized, see xson_handle_string() */
+    if (key_lex->state != LEX_STATE_STRING || key_lex->element != NULL) {
         return XSON_RESULT_INVALID_JSON;
     }
-    pair = xson_malloc(&ctx->pool, sizeof(struct xson_element));
-    if (pair == NULL) {
+    /* the pair pushed below takes the place of the key */
+    key = key_lex->start;
+    len = key_lex->end - key_lex->start + 1;
+    hash = key_lex->hash;
+    value = value_lex->element;
+    end = value_lex->end;
+    if (xson_stack_push(ctx, LEX_STATE_PAIR, key, end, NULL, *parent) == NULL) {
         return XSON_RESULT_OOM;
     }
-    xson_element_initialize(ctx, pair, ELE_TYPE_PAIR);
-    lex = xson_stack_push(ctx, LEX_STATE_PAIR, key_lex->start, value_lex->end, pair);
-    if (lex == NULL) {
-        return XSON_RESULT_OOM;
+
+    XSON_SET_PARENT(value, *parent);
+    return xson_object_add_member((*parent)->u.object, key, len, hash, value);
+}
+
+/* xson_projection_find() of a key that is not on the projection */
+#define XSON_PROJECTION_SKIP (-2)
+
+/*
+* Look up the key of @len bytes at @key under the projection node
+* of the object being parsed.
+* Return: the node of the key, -1 if its whole value is kept,
+*         XSON_PROJECTION_SKIP if the key is not on the projection.
+*/
+static int xson_projection_find(struct xson_context * ctx,
+                                const char * key, unsigned len) {
+    const struct xson_projection_node   *nodes = ctx->projection->nodes;
+    int                                 child;
+
+    for (child = nodes[ctx->proj_node].child; child >= 0;
+         child = nodes[child].sibling)
+        if (nodes[child].len == len && memcmp(nodes[child].key, key, len) == 0)
+            return nodes[child].leaf ? -1 : child;
+    return XSON_PROJECTION_SKIP;
+}
+
+static void xson_skip_blanks(char **cp) {
+    while(xson_is_blanks(**cp))
+        (*cp)++;
+}
+
+/*
+* Skip the value at @*cp without looking into it: the brackets are counted
+* and the strings skipped, the scalars are taken up to the next delimiter.
+* Return: XSON_RESULT_SUCCESS with @*cp at the last byte of the value,
+*         XSON_RESULT_INVALID_JSON if the string ends before the value.
+*/
+static int xson_skip_value(char ** cp) {
+    char    *p = *cp;
+    int     depth = 0;
+
+    if (*p != '{' && *p != '[' && *p != '\"') {
+        if (*p == '\0' || *p == ',' || *p == ':' || *p == '}' || *p == ']')
+            return XSON_RESULT_INVALID_JSON;
+        while (p[1] && p[1] != ',' && p[1] != '}' && p[1] != ']' &&
+               !xson_is_blanks(p[1]))
+            ++p;
+        *cp = p;
+        return XSON_RESULT_SUCCESS;
     }
-    if (pair->ops->initialize(pair, lex) == XSON_RESULT_OOM) {
-        return XSON_RESULT_OOM;
+
+    for (;; ++p) {
+        if (*p == '\"') {
+            for (++p; *p != '\"'; ++p)
+                if (*p == '\0' || (*p == '\\' && *++p == '\0'))
+                    return XSON_RESULT_INVALID_JSON;
+        } else if (*p == '{' || *p == '[') {
+            ++depth;
+        } else if (*p == '}' || *p == ']') {
+            --depth;
+        } else if (*p == '\0') {
+            return XSON_RESULT_INVALID_JSON;
+        }
+        if (depth == 0)
+            break;
     }
+    *cp = p;
+    return XSON_RESULT_SUCCESS;
+}
+
+/*
+* Skip the member of @parent whose key is on the top of the stack
+* and ends at @*cp, the member takes the place of the key as a pair
+* without value, as if it had been added.
+* Return: XSON_RESULT_SUCCESS with @*cp at the last byte of the value,
+*         XSON_RESULT_INVALID_JSON or XSON_RESULT_OOM on failure.
+*/
+static int xson_skip_member(struct xson_context * ctx,
+                            struct xson_element * parent, char ** cp) {
+    char    *key = xson_stack_pop(ctx)->start, *p = *cp + 1;
+
+    xson_skip_blanks(&p);
+    if (*p++ != ':')
+        return XSON_RESULT_INVALID_JSON;
+    xson_skip_blanks(&p);
+    if (xson_skip_value(&p) != XSON_RESULT_SUCCESS)
+        return XSON_RESULT_INVALID_JSON;
+    if (xson_stack_push(ctx, LEX_STATE_PAIR, key, p, NULL, parent) == NULL)
+        return XSON_RESULT_OOM;
+
+    *cp = p;
+    return XSON_RESULT_SUCCESS;
+}
 
-    pair_internal = pair->internal;
-    pair_internal->key = key;
-    pair_internal->value = value;
-    key->parent = pair;
-    value->parent = pair;
-    pair->parent = *parent;
+/*
+* Speculate that the key starting at @start is the same as the key at
+* the same position of the shape object, see xson_handle_open_object().
+* The prediction is dropped for the rest of the object on first miss.
+* Return: the key of the shape object predicted,
+*         NULL if the prediction failed.
+* @ctx: the context.
+* @obj: the object whose key is being parsed.
+* @start: the first character after the opening double quote.
+*/
+static struct xson_key_span *
+xson_predict_key(struct xson_context * ctx,
+                 struct xson_object * obj, char * start) {
+    struct xson_key_span    *key;
 
-    return (*parent)->ops->add_child(*parent, pair);
+    if (ctx->shape == NULL)
+        return NULL;
+    if (obj->idx >= ctx->shape->idx)
+        goto miss;
+
+    key = &ctx->shape->keys[obj->idx];
+
+    /*
+    * The predicted key is a valid string body itself,
+    * so the same bytes followed by a '"' form the same string.
+    */
+    if ((size_t)(ctx->str_buf + ctx->str_len - start) <= key->len ||
+        memcmp(start, key->start, key->len) != 0 || start[key->len] != '\"')
+        goto miss;
+
+    return key;
+miss:
+    ctx->shape = NULL;
+    return NULL;
 }
 
 static int
 xson_handle_string(struct xson_context * ctx,
                    struct xson_element ** parent, char **cp) {
-    int                     top_state;
+    int                     top_state, is_key;
     char                    *start, *end;
     struct xson_element     *e = NULL;
     struct xson_lex_element *lex = NULL;
+    struct xson_key_span    *predicted = NULL;
     
 
     top_state = xson_stack_top_state(ctx);
     if (XSON_LEFT_DQUOTE_COND) return XSON_RESULT_INVALID_JSON;
-    e = xson_malloc(&ctx->pool, sizeof(struct xson_element));
-    if (e == NULL) {
-        return XSON_RESULT_OOM;
-    }
 
     struct fsm_string fsms;
     start = *cp + 1;
-    if (fsm_string_run(&fsms, cp) == -1) {
+    /*  {"key" situation, try the key predicted by the previous record first. */
+    is_key = (*parent)->type == ELE_TYPE_OBJECT && top_state != LEX_STATE_COLON;
+    if (is_key)
+        predicted = xson_predict_key(ctx, (*parent)->u.object, start);
+    if (predicted) {
+        *cp = start + predicted->len;
+    } else if (fsm_string_run(&fsms, cp) == -1) {
         return XSON_RESULT_INVALID_JSON;
     }
     end = *cp - 1;
 
-    xson_element_initialize(ctx, e, ELE_TYPE_STRING);
-    lex = xson_stack_push(ctx, LEX_STATE_STRING, start, end, e);
+    /* a key only lives on the stack until its pair is formed */
+    if (is_key) {
+        lex = xson_stack_push(ctx, LEX_STATE_STRING, start, end, NULL, *parent);
+        if (lex == NULL) {
+            return XSON_RESULT_OOM;
+        }
+        if (predicted)
+            lex->hash = predicted->hash;
+        if (ctx->proj_node >= 0 &&
+            (lex->proj = xson_projection_find(ctx, start, end - start + 1)) ==
+            XSON_PROJECTION_SKIP)
+            return xson_skip_member(ctx, *parent, cp);
+        return XSON_RESULT_SUCCESS;
+    }
+
+    e = xson_malloc(&ctx->pool, sizeof(struct xson_element));
+    if (e == NULL) {
+        return XSON_RESULT_OOM;
+    }
+    xson_element_initialize(e, ELE_TYPE_STRING);
+    lex = xson_stack_push(ctx, LEX_STATE_STRING, start, end, e, *parent);
     if (lex == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (e->ops->initialize(e, lex) == XSON_RESULT_OOM) {
+    if (XSON_OPS(e)->initialize(ctx, e, lex) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
 
@@ -451,10 +615,7 @@ xson_handle_string(struct xson_context * ctx,
     if (top_state == LEX_STATE_COLON) {
         return xson_handle_pair(ctx, parent);
     }else {
-        /*  {"..." situation */
-        if ((*parent)->type == ELE_TYPE_OBJECT)return XSON_RESULT_SUCCESS;
-
-        return (*parent)->ops->add_child(*parent, e);
+        return XSON_OPS(*parent)->add_child(*parent, e);
     }
 }
 
@@ -481,12 +642,12 @@ xson_handle_number(struct xson_context * ctx,
     }
     end = *cp;
 
-    xson_element_initialize(ctx, e, ELE_TYPE_NUMBER);
-    lex = xson_stack_push(ctx, LEX_STATE_NUMBER, start, end, e);
+    xson_element_initialize(e, ELE_TYPE_NUMBER);
+    lex = xson_stack_push(ctx, LEX_STATE_NUMBER, start, end, e, *parent);
     if (lex == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (e->ops->initialize(e, lex) == XSON_RESULT_OOM) {
+    if (XSON_OPS(e)->initialize(ctx, e, lex) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
 
@@ -494,7 +655,7 @@ xson_handle_number(struct xson_context * ctx,
     if (top_state == LEX_STATE_COLON) {
         return xson_handle_pair(ctx, parent);
     }else {
-        return (*parent)->ops->add_child(*parent, e);
+        return XSON_OPS(*parent)->add_child(*parent, e);
     }
 }
 
@@ -523,13 +684,13 @@ xson_handle_bool(struct xson_context * ctx,
         end = *cp += 4;
     }
 
-    xson_element_initialize(ctx, e, ELE_TYPE_BOOL);
+    xson_element_initialize(e, ELE_TYPE_BOOL);
     /* same state as number apply to bool value */
-    lex = xson_stack_push(ctx, LEX_STATE_NUMBER, start, end, e);
+    lex = xson_stack_push(ctx, LEX_STATE_NUMBER, start, end, e, *parent);
     if (lex == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (e->ops->initialize(e, lex) == XSON_RESULT_OOM) {
+    if (XSON_OPS(e)->initialize(ctx, e, lex) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
 
@@ -537,7 +698,7 @@ xson_handle_bool(struct xson_context * ctx,
     if (top_state == LEX_STATE_COLON) {
         return xson_handle_pair(ctx, parent);
     }else {
-        return (*parent)->ops->add_child(*parent, e);
+        return XSON_OPS(*parent)->add_child(*parent, e);
     }
 }
 
@@ -561,13 +722,13 @@ xson_handle_null(struct xson_context * ctx,
     start = *cp;
     end = *cp += 3;
 
-    xson_element_initialize(ctx, e, ELE_TYPE_NULL);
+    xson_element_initialize(e, ELE_TYPE_NULL);
     /* same state as number apply to null value */
-    lex = xson_stack_push(ctx, LEX_STATE_NUMBER, start, end, e);
+    lex = xson_stack_push(ctx, LEX_STATE_NUMBER, start, end, e, *parent);
     if (lex == NULL) {
         return XSON_RESULT_OOM;
     }
-    if (e->ops->initialize(e, lex) == XSON_RESULT_OOM) {
+    if (XSON_OPS(e)->initialize(ctx, e, lex) == XSON_RESULT_OOM) {
         return XSON_RESULT_OOM;
     }
 
@@ -575,7 +736,7 @@ xson_handle_null(struct xson_context * ctx,
     if (top_state == LEX_STATE_COLON) {
         return xson_handle_pair(ctx, parent);
     }else {
-        return (*parent)->ops->add_child(*parent, e);
+        return XSON_OPS(*parent)->add_child(*parent, e);
     }
 }
 
@@ -583,20 +744,15 @@ static int
 xson_handle_comma(struct xson_context * ctx,
                   struct xson_element ** parent, char **cp) {
     int                 top_state;
-    struct xson_element *e;
     
 
     top_state = xson_stack_top_state(ctx);
     if (XSON_COMMA_COND) return XSON_RESULT_INVALID_JSON;
-    e = xson_malloc(&ctx->pool, sizeof(struct xson_element));
-    if (e == NULL) {
+    /* separators only live on the stack, no element is materialized */
+    if (xson_stack_push(ctx, LEX_STATE_COMMA, *cp, *cp, NULL, *parent) == NULL) {
         return XSON_RESULT_OOM;
     }
 
-    if (xson_stack_push(ctx, LEX_STATE_COMMA, *cp, *cp, e) == NULL) {
-        return XSON_RESULT_OOM;
-    }
-    e->parent = *parent;
     return XSON_RESULT_SUCCESS;
 }
 
@@ -604,20 +760,14 @@ static int
 xson_handle_colon(struct xson_context * ctx,
                   struct xson_element ** parent, char **cp) {
     int                 top_state;
-    struct xson_element *e;
     
 
     top_state = xson_stack_top_state(ctx);
     if (XSON_COMMA_COND) return XSON_RESULT_INVALID_JSON;
-    e = xson_malloc(&ctx->pool, sizeof(struct xson_element));
-    if (e == NULL) {
-        return XSON_RESULT_OOM;
-    }
-    
-    if (xson_stack_push(ctx, LEX_STATE_COLON, *cp, *cp, e) == NULL) {
+    /* separators only live on the stack, no element is materialized */
+    if (xson_stack_push(ctx, LEX_STATE_COLON, *cp, *cp, NULL, *parent) == NULL) {
         return XSON_RESULT_OOM;
     }
-    e->parent = *parent;
 
     return XSON_RESULT_SUCCESS;
 }
@@ -630,23 +780,33 @@ xson_handle_closed_object(struct xson_context * ctx,
     struct xson_lex_element *lex = NULL, *lex_under = NULL;
     
 
+    struct xson_object      *obj;
+    
+
     top_state = xson_stack_top_state(ctx);
     if (XSON_RIGHT_BRACE || (*parent)->type != ELE_TYPE_OBJECT)
         return XSON_RESULT_INVALID_JSON;
     lex = xson_stack_pop_until(ctx, LEX_STATE_LEFT_BRACE);
     if (lex == NULL)return XSON_RESULT_INVALID_JSON;
+    /* a large object gets a Bloom filter of its own */
+    obj = (*parent)->u.object;
+    if (ctx->bloom_min > 0 && obj->idx >= ctx->bloom_min &&
+        xson_pair_ht_own_bloom(&obj->ht, obj->keys, obj->idx) ==
+        XSON_RESULT_OOM)
+        return XSON_RESULT_OOM;
     lex_under = xson_stack_get_top_nr(ctx, 2);
     //turn it into a object
     lex->state = LEX_STATE_OBJECT;
 
+    //back to the enclosing element
+    *parent = lex->parent;
+    ctx->proj_node = lex->proj;
+    ctx->shape = lex->shape;
+
     //we got a pair forming up
-    if (lex_under && lex_under->state == LEX_STATE_COLON) {
-        *parent = lex_under->element->parent;
+    if (lex_under && lex_under->state == LEX_STATE_COLON)
         return xson_handle_pair(ctx, parent);
-    }else {
-        *parent = (*parent)->parent;
-        return XSON_RESULT_SUCCESS;
-    }
+    return XSON_RESULT_SUCCESS;
 }
 
 static int
@@ -665,30 +825,58 @@ xson_handle_closed_array(struct xson_context * ctx,
     //turn it into a array
     lex->state = LEX_STATE_ARRAY;
 
+    //back to the enclosing element
+    *parent = lex->parent;
+    ctx->proj_node = lex->proj;
+
     //we got a pair forming up
-    if (lex_under && lex_under->state == LEX_STATE_COLON) {
-        *parent = lex_under->element->parent;
+    if (lex_under && lex_under->state == LEX_STATE_COLON)
         return xson_handle_pair(ctx, parent);
-    }else {
-        *parent = (*parent)->parent;
-        return XSON_RESULT_SUCCESS;
-    }
+    return XSON_RESULT_SUCCESS;
 }
 
-static void xson_skip_blanks(char **cp) {
-    while(xson_is_blanks(**cp))
-        (*cp)++;
+int xson_parse(struct xson_context * ctx, struct xson_element ** out) {
+    int ret;
+    assert(ctx != NULL);
+
+    ret = xson_parse_range(ctx, ctx->root, ctx->str_buf,
+                           ctx->str_buf + ctx->str_len);
+    if (ret == XSON_RESULT_SUCCESS)
+        *out = ctx->root;
+
+    return ret;
 }
 
-int xson_parse(struct xson_context * ctx, struct xson_element ** out) {
-    char * cp = ctx->str_buf;
+int xson_parse_projected(struct xson_context * ctx,
+                         const struct xson_projection * proj,
+                         struct xson_element ** out) {
     int ret;
-    struct xson_element * parent = NULL;
     assert(ctx != NULL);
+    assert(proj != NULL);
 
-    parent = ctx->root;
+    ctx->projection = proj;
+    ctx->proj_node = proj->nodes[0].leaf ? -1 : 0;
+    ret = xson_parse(ctx, out);
+    ctx->projection = NULL;
+    ctx->proj_node = -1;
+
+    return ret;
+}
+
+int xson_parse_range(struct xson_context * ctx, struct xson_element * root,
+                     char * start, char * end) {
+    char * cp = start, * near;
+    int ret;
+    struct xson_element * parent = root;
+    assert(ctx != NULL);
+    assert(root != NULL && root->type == ELE_TYPE_ROOT);
 
-    while (*cp) {
+    ctx->stack[0].state = LEX_STATE_EMPTY;
+    ctx->stack[0].element = root;
+    ctx->stk_top = 1;
+    ctx->shape = NULL;
+
+    while (cp < end && *cp) {
         xson_skip_blanks(&cp);
         if (*cp == '{') {/* open object */
             ret = xson_handle_open_object(ctx, &parent, &cp);
@@ -720,24 +908,16 @@ int xson_parse(struct xson_context * ctx, struct xson_element ** out) {
         ++cp;
     }
 
-    if (parent != ctx->root || ctx->stk_top > 2 ||
+    if (parent != root || ctx->stk_top > 2 ||
        (xson_stack_top_state(ctx) != LEX_STATE_OBJECT &&
        xson_stack_top_state(ctx) != LEX_STATE_ARRAY))goto error;
 
-    *out = ctx->root;
-
     return 0;
 
 invalid_json:
-    if (cp + 10 < cp + ctx->str_len) {
-        cp[10] = '\0';
-    }
-    if (cp - 10 >= ctx->str_buf) {
-        cp -= 10;
-    }else {
-        cp = ctx->str_buf;
-    }
-    printf("xson parser: eek, invalid json string near '%s' !\n", cp);
+    near = cp - 10 >= start ? cp - 10 : start;
+    printf("xson parser: eek, invalid json string near '%.*s' !\n",
+           (int)(cp + 10 < end ? cp + 10 - near : end - near), near);
     return XSON_RESULT_INVALID_JSON;
 oom:
     printf("xson parser: out of memory!\n");
@@ -748,6 +928,157 @@ error:
 
 }
 
+int xson_freeze(struct xson_context * ctx) {
+    int ret;
+    assert(ctx != NULL);
+
+    if (ctx->frozen)
+        return XSON_RESULT_SUCCESS;
+
+    if ((ret = XSON_OPS(ctx->root)->freeze(ctx->root)) != XSON_RESULT_SUCCESS)
+        return ret;
+    ctx->frozen = 1;
+
+    return XSON_RESULT_SUCCESS;
+}
+
+int xson_enable_lookup_cache(struct xson_context * ctx, int size) {
+    struct xson_lookup_entry    *cache = NULL;
+    unsigned                    len = 0;
+    assert(ctx != NULL);
+
+    if (size > 0) {
+        for (len = 1; len < (unsigned)size; len <<= 1)
+            ;
+        if (len == ctx->cache_len)
+            return XSON_RESULT_SUCCESS;
+        if ((cache = xson_malloc(&ctx->pool,
+                                 len * sizeof(struct xson_lookup_entry))) == NULL)
+            return XSON_RESULT_OOM;
+        memset(cache, 0, len * sizeof(struct xson_lookup_entry));
+    }
+    if (ctx->cache)
+        xmpool_free(&ctx->pool, ctx->cache,
+                    ctx->cache_len * sizeof(struct xson_lookup_entry));
+    ctx->cache = cache;
+    ctx->cache_len = len;
+
+    return XSON_RESULT_SUCCESS;
+}
+
+int xson_enable_bloom_filters(struct xson_context * ctx, int min_members) {
+    assert(ctx != NULL);
+
+    if (ctx->root->u.value.child)
+        return XSON_RESULT_OP_NOTSUPPORTED;
+    if (ctx->bloom == NULL &&
+        (ctx->bloom = xson_key_bloom_new(&ctx->pool, (size_t)ctx->str_len /
+                                         XSON_CTX_BLOOM_BYTES_PER_KEY *
+                                         XSON_KEY_BLOOM_BITS_PER_KEY)) == NULL)
+        return XSON_RESULT_OOM;
+    ctx->bloom_min = min_members > 0 ? min_members : 0;
+
+    return XSON_RESULT_SUCCESS;
+}
+
+#define XSON_POOL_SIZEOF(size) XM_ALIGN((size), XM_ALIGNMENT)
+
+/*
+* Account for @ele and everything under it in @stats.
+*/
+static void xson_element_memory_stats(struct xson_element * ele,
+                                      struct xson_mem_stats * stats) {
+    struct xson_object  *obj;
+    struct xson_array   *array;
+    size_t              internal;
+    int                 i;
+
+    /* scalars and the root are inline, containers are allocated apart */
+    switch (ele->type) {
+        case ELE_TYPE_OBJECT:
+            internal = sizeof(struct xson_object);
+            break;
+        case ELE_TYPE_ARRAY:
+            internal = sizeof(struct xson_array);
+            break;
+        default:
+            internal = 0;
+            break;
+    }
+    ++stats->elements[ele->type];
+    stats->element_bytes[ele->type] +=
+        XSON_POOL_SIZEOF(sizeof(struct xson_element)) +
+        (internal ? XSON_POOL_SIZEOF(internal) : 0);
+
+    switch (ele->type) {
+        case ELE_TYPE_ROOT:
+            if (ele->u.value.child)
+                xson_element_memory_stats(ele->u.value.child, stats);
+            break;
+        case ELE_TYPE_OBJECT:
+            obj = ele->u.object;
+            stats->hash_table_bytes += xson_pair_ht_memory(&obj->ht);
+            if (obj->ht.bloom && obj->ht.bloom != obj->ctx->bloom)
+                stats->bloom_bytes += xson_key_bloom_memory(obj->ht.bloom);
+            stats->child_vector_bytes +=
+                XSON_POOL_SIZEOF(obj->size * sizeof(struct xson_key_span)) +
+                XSON_POOL_SIZEOF(obj->size * sizeof(struct xson_element *));
+            stats->child_vector_unused += (obj->size - obj->idx) *
+                (sizeof(struct xson_key_span) + sizeof(struct xson_element *));
+            stats->elements[ELE_TYPE_PAIR] += obj->idx;
+            for (i = 0; i < obj->idx; ++i)
+                xson_element_memory_stats(obj->values[i], stats);
+            break;
+        case ELE_TYPE_ARRAY:
+            array = ele->u.array;
+            stats->child_vector_bytes += XSON_POOL_SIZEOF(
+                array->size * sizeof(struct xson_element *));
+            stats->child_vector_unused +=
+                (array->size - array->idx) * sizeof(struct xson_element *);
+            for (i = 0; i < array->idx; ++i)
+                xson_element_memory_stats(array->array[i], stats);
+            break;
+        default:
+            break;
+    }
+}
+
+void xson_memory_stats(struct xson_context * ctx,
+                       struct xson_mem_stats * stats) {
+    struct xmpool_usage_t   usage;
+    size_t                  referenced;
+    int                     i;
+    assert(ctx != NULL);
+    assert(stats != NULL);
+
+    memset(stats, 0, sizeof(*stats));
+    xmpool_usage(&ctx->pool, &usage);
+    stats->pool_bytes = usage.bytes;
+    stats->pool_peak_bytes = usage.peak_bytes;
+    stats->chunk_used = usage.chunk_used;
+    stats->large_used = usage.large_used;
+    stats->chunk_wasted = usage.chunk_wasted;
+    stats->chunk_free = usage.chunk_free + usage.chunk_spare;
+    stats->free_listed_bytes = usage.free_listed;
+
+    stats->string_bytes = XSON_POOL_SIZEOF(ctx->str_len + 1);
+    stats->lex_stack_bytes = XSON_POOL_SIZEOF(ctx->stk_len *
+                                              sizeof(struct xson_lex_element));
+    if (ctx->bloom)
+        stats->bloom_bytes = xson_key_bloom_memory(ctx->bloom);
+    xson_element_memory_stats(ctx->root, stats);
+
+    referenced = stats->hash_table_bytes + stats->bloom_bytes +
+                 stats->child_vector_bytes +
+                 stats->string_bytes + stats->lex_stack_bytes +
+                 stats->free_listed_bytes;
+    for (i = 0; i <= ELE_TYPE_NULL; ++i)
+        referenced += stats->element_bytes[i];
+    if (usage.chunk_used + usage.large_used > referenced)
+        stats->unreferenced_bytes = usage.chunk_used + usage.large_used -
+                                    referenced;
+}
+
 /*
 * Clean and free up the context.
 * @ctx: the context being destroyed.
@@ -755,22 +1086,25 @@ error:
 void xson_destroy(struct xson_context * ctx) {
     assert(ctx != NULL);
 
-    if (ctx->str_buf) {
-        free(ctx->str_buf);
-        ctx->str_buf = NULL;
-        ctx->str_len = 0;
-    }
-    if (ctx->stack) {
-        free(ctx->stack);
-        ctx->stack = NULL;
-        ctx->stk_len = 0;
-    }
-    ctx->root->ops->destroy(ctx->root);
+    /* everything, the string copy and the lex stack included, lives in the pool */
     xmpool_destroy(&ctx->pool);
+    ctx->str_buf = NULL;
+    ctx->str_len = 0;
+    ctx->stack = NULL;
+    ctx->stk_len = 0;
+    ctx->cache = NULL;
+    ctx->cache_len = 0;
+    ctx->lazy = NULL;
+    ctx->lazy_len = 0;
+    ctx->projection = NULL;
+    ctx->proj_node = -1;
+    ctx->shape = NULL;
+    ctx->bloom = NULL;
+    ctx->bloom_min = 0;
 }
 
 void xson_print(struct xson_context * ctx, int indent) {
     assert(ctx != NULL);
     assert(ctx->root != NULL && ctx->root->type == ELE_TYPE_ROOT);
-    ctx->root->ops->print(ctx->root, 0, indent, 0);
+    XSON_OPS(ctx->root)->print(ctx->root, 0, indent, 0);
 }
\ No newline at end of file
@@ -0,0 +1,463 @@
+/*
+* Copyright (c) 2014 Xinjing Cho
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+* 3. The name of the author may not be used to endorse or promote products
+*    derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERR
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "xson/types.h"
+#include "xson/path.h"
+
+/*
+* Scan @expr once.
+* Return: the number of steps, -1 if @expr is invalid.
+* @steps: filled with the steps if not NULL.
+* @keys: the key bytes are copied there if @steps is not NULL.
+*/
+static int xson_path_scan(const char * expr, struct xson_path_step * steps,
+                          char * keys) {
+    const char  *cp = expr, *key;
+    int         n = 0, index;
+    size_t      len;
+
+    for (;;) {
+        /* the key, empty only in front of an index of the first segment */
+        for (key = cp; *cp && *cp != '.' && *cp != '['; ++cp)
+            ;
+        len = cp - key;
+        if (len == 0 && (n > 0 || *cp != '['))
+            return -1;
+        if (len > 0) {
+            if (steps) {
+                memcpy(keys, key, len);
+                steps[n].key = keys;
+                steps[n].len = len;
+                steps[n].hash = xson_pair_ht_hash(key, len);
+                steps[n].index = 0;
+                keys += len;
+            }
+            ++n;
+        }
+
+        /* the indexes */
+        while (*cp == '[') {
+            ++cp;
+            if (*cp < '0' || *cp > '9')
+                return -1;
+            for (index = 0; *cp >= '0' && *cp <= '9'; ++cp) {
+                if (index > (0x7fffffff - (*cp - '0')) / 10)
+                    return -1;
+                index = index * 10 + (*cp - '0');
+            }
+            if (*cp++ != ']')
+                return -1;
+            if (steps) {
+                steps[n].key = NULL;
+                steps[n].len = 0;
+                steps[n].hash = 0;
+                steps[n].index = index;
+            }
+            ++n;
+        }
+
+        if (*cp == '\0')
+            return n;
+        if (*cp++ != '.')
+            return -1;
+    }
+}
+
+struct xson_path * xson_path_compile(const char * expr) {
+    return xson_path_compile_with_allocator(expr, &xmpool_default_allocator);
+}
+
+struct xson_path *
+xson_path_compile_with_allocator(const char * expr,
+                                 const struct xmpool_allocator_t * allocator) {
+    struct xson_path    *path;
+    int                 n;
+    assert(expr != NULL);
+    assert(allocator != NULL);
+
+    if (expr == NULL || allocator == NULL ||
+        (n = xson_path_scan(expr, NULL, NULL)) < 0)
+        return NULL;
+
+    path = XM_ALLOC(allocator, sizeof(struct xson_path) +
+                    n * sizeof(struct xson_path_step) + strlen(expr));
+    if (path == NULL)
+        return NULL;
+    path->n_steps = n;
+    path->steps = (struct xson_path_step *)(path + 1);
+    path->allocator = allocator;
+    xson_path_scan(expr, path->steps, (char *)(path->steps + n));
+
+    return path;
+}
+
+/*
+* Take a step from @elt, which is not a root element.
+* Return: see xson_path_eval().
+*/
+static inline struct xson_element *
+xson_path_step_eval(struct xson_element * elt,
+                    const struct xson_path_step * step) {
+    struct xson_object  *obj;
+    struct xson_array   *array;
+    int                 i;
+
+    if (step->key) {
+        if (elt->type != ELE_TYPE_OBJECT)
+            return XSON_EXPR_TYPE_MISMATCH;
+        obj = elt->u.object;
+        i = xson_pair_ht_retrieve(&obj->ht, obj->keys, step->key,
+                                  step->len, step->hash);
+        if (i < 0)
+            return XSON_EXPR_KEY_NOT_EXIST;
+        return obj->values[i];
+    } else {
+        if (elt->type != ELE_TYPE_ARRAY)
+            return XSON_EXPR_TYPE_MISMATCH;
+        array = elt->u.array;
+        if (step->index >= array->idx)
+            return XSON_EXPR_INDEX_OOR;
+        return array->array[step->index];
+    }
+}
+
+struct xson_element * xson_path_eval(struct xson_element * elt,
+                                     const struct xson_path * path) {
+    const struct xson_path_step *step, *end;
+
+    if (elt == NULL || path == NULL)
+        return XSON_EXPR_NULL;
+    if (elt->type == ELE_TYPE_ROOT && (elt = elt->u.value.child) == NULL)
+        return XSON_EXPR_NULL;
+
+    for (step = path->steps, end = step + path->n_steps; step < end; ++step) {
+        elt = xson_path_step_eval(elt, step);
+        if (!XSON_GOOD_ELEMENT(elt))
+            return elt;
+    }
+
+    return elt;
+}
+
+void xson_path_free(struct xson_path * path) {
+    if (path)
+        XM_FREE(path->allocator, path);
+}
+
+/* a node of the trie while it is built */
+struct xson_extract_tmp {
+    struct xson_path_step *step;
+    int parent, child, sibling, field;
+};
+
+static int xson_path_step_equal(const struct xson_path_step * a,
+                                const struct xson_path_step * b) {
+    if (a->key == NULL || b->key == NULL)
+        return a->key == b->key && a->index == b->index;
+    return a->hash == b->hash && a->len == b->len &&
+           memcmp(a->key, b->key, a->len) == 0;
+}
+
+struct xson_extractor *
+xson_extractor_compile(const struct xson_field * fields, int n) {
+    return xson_extractor_compile_with_allocator(fields, n,
+                                                 &xmpool_default_allocator);
+}
+
+struct xson_extractor *
+xson_extractor_compile_with_allocator(const struct xson_field * fields, int n,
+                                      const struct xmpool_allocator_t * allocator) {
+    struct xson_extractor       *ex = NULL;
+    struct xson_extract_tmp     *tmp = NULL;
+    struct xson_path            **paths;
+    struct xson_path_step       *step;
+    int                         i, j, cur, child, n_tmp, total, depth;
+    assert(fields != NULL);
+    assert(allocator != NULL);
+
+    if (fields == NULL || n <= 0 || allocator == NULL)
+        return NULL;
+
+    paths = XM_ALLOC(allocator, n * sizeof(struct xson_path *));
+    if (paths == NULL)
+        return NULL;
+    for (i = 0, total = 0; i < n; ++i) {
+        if (fields[i].expr == NULL ||
+            (paths[i] = xson_path_compile_with_allocator(fields[i].expr,
+                                                         allocator)) == NULL)
+            goto failed;
+        total += paths[i]->n_steps;
+    }
+
+    ex = XM_ALLOC(allocator, sizeof(struct xson_extractor) +
+                  n * sizeof(struct xson_extract_field) +
+                  total * sizeof(struct xson_extract_node));
+    tmp = XM_ALLOC(allocator, (total + 1) * sizeof(struct xson_extract_tmp));
+    if (ex == NULL || tmp == NULL)
+        goto failed;
+    ex->n_fields = n;
+    ex->fields = (struct xson_extract_field *)(ex + 1);
+    ex->nodes = (struct xson_extract_node *)(ex->fields + n);
+    ex->n_nodes = 0;
+    ex->max_depth = 0;
+    ex->paths = paths;
+    ex->allocator = allocator;
+
+    /* merge the paths into a trie, node 0 stands for the element walked */
+    tmp[0].parent = tmp[0].child = tmp[0].sibling = tmp[0].field = -1;
+    for (i = 0, n_tmp = 1; i < n; ++i) {
+        cur = 0;
+        for (j = 0; j < paths[i]->n_steps; ++j) {
+            step = &paths[i]->steps[j];
+            for (child = tmp[cur].child; child >= 0; child = tmp[child].sibling)
+                if (xson_path_step_equal(tmp[child].step, step))
+                    break;
+            if (child < 0) {
+                child = n_tmp++;
+                tmp[child].step = step;
+                tmp[child].parent = cur;
+                tmp[child].child = tmp[child].field = -1;
+                tmp[child].sibling = tmp[cur].child;
+                tmp[cur].child = child;
+            }
+            cur = child;
+        }
+        ex->fields[i].type = fields[i].type;
+        ex->fields[i].next = tmp[cur].field;
+        tmp[cur].field = i;
+        if (paths[i]->n_steps > ex->max_depth)
+            ex->max_depth = paths[i]->n_steps;
+    }
+
+    /* lay the trie out depth first, so that a parent precedes its children */
+    for (cur = tmp[0].child, depth = 1; cur >= 0; ) {
+        ex->nodes[ex->n_nodes].step = *tmp[cur].step;
+        ex->nodes[ex->n_nodes].depth = depth;
+        ex->nodes[ex->n_nodes].field = tmp[cur].field;
+        ++ex->n_nodes;
+        if (tmp[cur].child >= 0) {
+            cur = tmp[cur].child;
+            ++depth;
+            continue;
+        }
+        while (cur > 0 && tmp[cur].sibling < 0) {
+            cur = tmp[cur].parent;
+            --depth;
+        }
+        cur = cur > 0 ? tmp[cur].sibling : -1;
+    }
+
+    XM_FREE(allocator, tmp);
+    return ex;
+failed:
+    while (--i >= 0)
+        xson_path_free(paths[i]);
+    XM_FREE(allocator, paths);
+    if (ex)
+        XM_FREE(allocator, ex);
+    if (tmp)
+        XM_FREE(allocator, tmp);
+    return NULL;
+}
+
+/*
+* Convert the element a field leads to.
+* Return: 1 if the field is extracted, 0 otherwise.
+*/
+static int xson_field_fill(struct xson_field_value * value,
+                           enum xson_field_type type,
+                           struct xson_element * elt) {
+    if (!XSON_GOOD_ELEMENT(elt)) {
+        value->elt = NULL;
+        value->result = xson_convert_expr_res_to_res(elt);
+        return 0;
+    }
+    value->elt = elt;
+
+    switch (type) {
+    case XSON_FIELD_LLONG:
+        value->result = elt->type != ELE_TYPE_NUMBER ?
+                        XSON_RESULT_TYPE_MISMATCH :
+                        xson_number_to_llong(&elt->u.number, &value->u.llong);
+        break;
+    case XSON_FIELD_DOUBLE:
+        value->result = elt->type != ELE_TYPE_NUMBER ?
+                        XSON_RESULT_TYPE_MISMATCH :
+                        xson_number_to_double(&elt->u.number, &value->u.dbl);
+        break;
+    case XSON_FIELD_BOOL:
+        value->result = elt->type != ELE_TYPE_BOOL ?
+                        XSON_RESULT_TYPE_MISMATCH :
+                        xson_bool_to_int(&elt->u.xbool, &value->u.xbool);
+        break;
+    case XSON_FIELD_STRING:
+        if (elt->type != ELE_TYPE_STRING) {
+            value->result = XSON_RESULT_TYPE_MISMATCH;
+        } else {
+            value->u.string = elt->u.string;
+            value->result = XSON_RESULT_SUCCESS;
+        }
+        break;
+    default:
+        value->result = XSON_RESULT_SUCCESS;
+        break;
+    }
+    return value->result == XSON_RESULT_SUCCESS;
+}
+
+int xson_extract(struct xson_element * elt, const struct xson_extractor * ex,
+                 struct xson_field_value * values) {
+    struct xson_element             *stack[XSON_VISIT_STACK_DEPTH + 1];
+    struct xson_element             **cur = stack;
+    const struct xson_extract_node  *node, *end;
+    struct xson_element             *from;
+    int                             f, found = 0;
+
+    if (elt == NULL || ex == NULL || values == NULL)
+        return XSON_RESULT_ERROR;
+    if (elt->type == ELE_TYPE_ROOT)
+        elt = elt->u.value.child ? elt->u.value.child : XSON_EXPR_NULL;
+    if (ex->max_depth > XSON_VISIT_STACK_DEPTH &&
+        (cur = XM_ALLOC(ex->allocator, (ex->max_depth + 1) *
+                        sizeof(struct xson_element *))) == NULL)
+        return XSON_RESULT_OOM;
+
+    /* cur[d] is the element reached by the last node of depth d */
+    cur[0] = elt;
+    for (node = ex->nodes, end = node + ex->n_nodes; node < end; ++node) {
+        from = cur[node->depth - 1];
+        cur[node->depth] = XSON_GOOD_ELEMENT(from) ?
+                           xson_path_step_eval(from, &node->step) : from;
+        for (f = node->field; f >= 0; f = ex->fields[f].next)
+            found += xson_field_fill(&values[f], ex->fields[f].type,
+                                     cur[node->depth]);
+    }
+
+    if (cur != stack)
+        XM_FREE(ex->allocator, cur);
+    return found;
+}
+
+void xson_extractor_free(struct xson_extractor * ex) {
+    int i;
+
+    if (ex == NULL)
+        return;
+    for (i = 0; i < ex->n_fields; ++i)
+        xson_path_free(ex->paths[i]);
+    XM_FREE(ex->allocator, ex->paths);
+    XM_FREE(ex->allocator, ex);
+}
+
+struct xson_projection *
+xson_projection_compile(const char * const * exprs, int n) {
+    return xson_projection_compile_with_allocator(exprs, n,
+                                                  &xmpool_default_allocator);
+}
+
+struct xson_projection *
+xson_projection_compile_with_allocator(const char * const * exprs, int n,
+                                       const struct xmpool_allocator_t * allocator) {
+    struct xson_projection      *proj = NULL;
+    struct xson_projection_node *nodes;
+    struct xson_path            **paths;
+    struct xson_path_step       *step;
+    int                         i, j, cur, child, total;
+    assert(exprs != NULL);
+    assert(allocator != NULL);
+
+    if (exprs == NULL || n <= 0 || allocator == NULL)
+        return NULL;
+
+    paths = XM_ALLOC(allocator, n * sizeof(struct xson_path *));
+    if (paths == NULL)
+        return NULL;
+    for (i = 0, total = 1; i < n; ++i) {
+        if (exprs[i] == NULL ||
+            (paths[i] = xson_path_compile_with_allocator(exprs[i],
+                                                         allocator)) == NULL)
+            goto failed;
+        total += paths[i]->n_steps;
+    }
+
+    proj = XM_ALLOC(allocator, sizeof(struct xson_projection) +
+                    total * sizeof(struct xson_projection_node));
+    if (proj == NULL)
+        goto failed;
+    nodes = proj->nodes = (struct xson_projection_node *)(proj + 1);
+    proj->n_paths = n;
+    proj->paths = paths;
+    proj->allocator = allocator;
+
+    /* merge the keys of the paths into a trie */
+    nodes[0].key = NULL;
+    nodes[0].len = 0;
+    nodes[0].leaf = 0;
+    nodes[0].child = nodes[0].sibling = -1;
+    for (i = 0, proj->n_nodes = 1; i < n; ++i) {
+        cur = 0;
+        for (j = 0; j < paths[i]->n_steps && !nodes[cur].leaf; ++j) {
+            step = &paths[i]->steps[j];
+            if (step->key == NULL)
+                continue;
+            for (child = nodes[cur].child; child >= 0;
+                 child = nodes[child].sibling)
+                if (nodes[child].len == step->len &&
+                    memcmp(nodes[child].key, step->key, step->len) == 0)
+                    break;
+            if (child < 0) {
+                child = proj->n_nodes++;
+                nodes[child].key = step->key;
+                nodes[child].len = step->len;
+                nodes[child].leaf = 0;
+                nodes[child].child = -1;
+                nodes[child].sibling = nodes[cur].child;
+                nodes[cur].child = child;
+            }
+            cur = child;
+        }
+        /* a shorter path keeps what the longer ones would pick from */
+        nodes[cur].leaf = 1;
+    }
+
+    return proj;
+failed:
+    while (--i >= 0)
+        xson_path_free(paths[i]);
+    XM_FREE(allocator, paths);
+    return NULL;
+}
+
+void xson_projection_free(struct xson_projection * proj) {
+    int i;
+
+    if (proj == NULL)
+        return;
+    for (i = 0; i < proj->n_paths; ++i)
+        xson_path_free(proj->paths[i]);
+    XM_FREE(proj->allocator, proj->paths);
+    XM_FREE(proj->allocator, proj);
+}
@@ -0,0 +1,612 @@
+/*
+* Copyright (c) 2014 Xinjing Cho
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+* 3. The name of the author may not be used to endorse or promote products
+*    derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERR
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "xson/types.h"
+#include "xson/query.h"
+
+#define XSON_QUERY_SKIP_SPACES(cp) while (*(cp) == ' ' || *(cp) == '\t') ++(cp)
+
+/*
+* The expression is scanned twice: once to count the operations and
+* the filters, with @query NULL, then to fill them in @query.
+*/
+struct xson_query_scan {
+    char                            *cp;
+    struct xson_query               *query;
+    struct xson_query_filter        *filters;
+    int                             n_ops, n_filters;
+    const struct xmpool_allocator_t *allocator;
+    /* written while counting */
+    struct xson_query_op            op;
+    struct xson_query_filter        filter;
+};
+
+static struct xson_query_op *
+xson_query_add_op(struct xson_query_scan * s, enum xson_query_op_type type) {
+    struct xson_query_op *op;
+
+    if (s->query) {
+        op = &s->query->ops[s->n_ops];
+        s->query->n_ops = s->n_ops + 1;
+    } else {
+        op = &s->op;
+    }
+    ++s->n_ops;
+    memset(op, 0, sizeof(struct xson_query_op));
+    op->type = type;
+    return op;
+}
+
+static void xson_query_add_key(struct xson_query_scan * s,
+                               const char * key, size_t len) {
+    struct xson_query_op *op = xson_query_add_op(s, XSON_QUERY_KEY);
+
+    op->key = key;
+    op->len = len;
+    op->hash = xson_pair_ht_hash(key, len);
+}
+
+/*
+* Return: 1 if an integer was scanned, 0 if there is none, -1 if it overflows.
+*/
+static int xson_query_scan_int(char ** cpp, int * out) {
+    char    *end;
+    long    v;
+
+    XSON_QUERY_SKIP_SPACES(*cpp);
+    if (**cpp != '-' && (**cpp < '0' || **cpp > '9'))
+        return 0;
+    v = strtol(*cpp, &end, 10);
+    if (end == *cpp)
+        return 0;
+    if (v > INT_MAX || v < -INT_MAX)
+        return -1;
+    *cpp = end;
+    *out = v;
+    XSON_QUERY_SKIP_SPACES(*cpp);
+    return 1;
+}
+
+/*
+* Scan a filter "?(@... op literal)", *@cpp points at '?'.
+* Return: 0 on success, -1 if the filter is invalid or out of memory.
+*/
+static int xson_query_scan_filter(struct xson_query_scan * s, char ** cpp) {
+    struct xson_query_op        *op;
+    struct xson_query_filter    *f;
+    char                        *cp = *cpp + 1, *rel, *end, c;
+
+    XSON_QUERY_SKIP_SPACES(cp);
+    if (*cp++ != '(')
+        return -1;
+    XSON_QUERY_SKIP_SPACES(cp);
+    if (*cp++ != '@')
+        return -1;
+
+    op = xson_query_add_op(s, XSON_QUERY_FILTER);
+    f = s->query ? &s->filters[s->n_filters] : &s->filter;
+    ++s->n_filters;
+    memset(f, 0, sizeof(struct xson_query_filter));
+    op->filter = f;
+
+    /* the path relative to @ */
+    for (rel = cp; *cp && !strchr(" \t=!<>)", *cp); ++cp)
+        ;
+    if (cp > rel) {
+        if (*rel == '.')
+            ++rel;
+        else if (*rel != '[')
+            return -1;
+        if (rel == cp)
+            return -1;
+        if (s->query) {
+            /* the copy of the expression is ours to cut */
+            c = *cp;
+            *cp = '\0';
+            f->path = xson_path_compile_with_allocator(rel, s->allocator);
+            *cp = c;
+            if (f->path == NULL)
+                return -1;
+        }
+    }
+
+    XSON_QUERY_SKIP_SPACES(cp);
+    if (*cp == ')') {
+        f->cmp = XSON_QUERY_EXISTS;
+        *cpp = cp + 1;
+        return 0;
+    }
+    if (cp[0] == '=' && cp[1] == '=')
+        f->cmp = XSON_QUERY_EQ;
+    else if (cp[0] == '!' && cp[1] == '=')
+        f->cmp = XSON_QUERY_NE;
+    else if (cp[0] == '<' && cp[1] == '=')
+        f->cmp = XSON_QUERY_LE;
+    else if (cp[0] == '>' && cp[1] == '=')
+        f->cmp = XSON_QUERY_GE;
+    else if (cp[0] == '<')
+        f->cmp = XSON_QUERY_LT;
+    else if (cp[0] == '>')
+        f->cmp = XSON_QUERY_GT;
+    else
+        return -1;
+    cp += f->cmp == XSON_QUERY_LT || f->cmp == XSON_QUERY_GT ? 1 : 2;
+    XSON_QUERY_SKIP_SPACES(cp);
+
+    /* the literal */
+    if (*cp == '\'' || *cp == '"') {
+        c = *cp++;
+        for (f->string = cp; *cp && *cp != c; ++cp)
+            ;
+        if (*cp == '\0')
+            return -1;
+        f->len = cp++ - f->string;
+        f->type = ELE_TYPE_STRING;
+    } else if (strncmp(cp, "true", 4) == 0) {
+        f->type = ELE_TYPE_BOOL;
+        f->xbool = 1;
+        cp += 4;
+    } else if (strncmp(cp, "false", 5) == 0) {
+        f->type = ELE_TYPE_BOOL;
+        f->xbool = 0;
+        cp += 5;
+    } else if (strncmp(cp, "null", 4) == 0) {
+        f->type = ELE_TYPE_NULL;
+        cp += 4;
+    } else {
+        f->number = strtod(cp, &end);
+        if (end == cp)
+            return -1;
+        f->type = ELE_TYPE_NUMBER;
+        cp = end;
+    }
+
+    XSON_QUERY_SKIP_SPACES(cp);
+    if (*cp != ')')
+        return -1;
+    *cpp = cp + 1;
+    return 0;
+}
+
+/*
+* Scan a bracket "[...]", @s->cp points at '['.
+* Return: 0 on success, -1 if the bracket is invalid or out of memory.
+*/
+static int xson_query_scan_bracket(struct xson_query_scan * s) {
+    struct xson_query_op    *op;
+    char                    *cp = s->cp + 1, *key, quote;
+    int                     start = 0, end = 0, step = 1;
+    int                     has_start, has_end, has_step;
+
+    XSON_QUERY_SKIP_SPACES(cp);
+    if (*cp == '*') {
+        xson_query_add_op(s, XSON_QUERY_WILDCARD);
+        ++cp;
+    } else if (*cp == '\'' || *cp == '"') {
+        quote = *cp++;
+        for (key = cp; *cp && *cp != quote; ++cp)
+            ;
+        if (*cp == '\0')
+            return -1;
+        xson_query_add_key(s, key, cp++ - key);
+    } else if (*cp == '?') {
+        if (xson_query_scan_filter(s, &cp) < 0)
+            return -1;
+    } else {
+        if ((has_start = xson_query_scan_int(&cp, &start)) < 0)
+            return -1;
+        if (*cp != ':') {
+            if (!has_start)
+                return -1;
+            op = xson_query_add_op(s, XSON_QUERY_INDEX);
+            op->start = start;
+        } else {
+            ++cp;
+            if ((has_end = xson_query_scan_int(&cp, &end)) < 0)
+                return -1;
+            if (*cp == ':') {
+                ++cp;
+                has_step = xson_query_scan_int(&cp, &step);
+                if (has_step < 0 || (has_step && step == 0))
+                    return -1;
+            }
+            op = xson_query_add_op(s, XSON_QUERY_SLICE);
+            op->start = start;
+            op->end = end;
+            op->step = step;
+            op->has_start = has_start;
+            op->has_end = has_end;
+        }
+    }
+
+    XSON_QUERY_SKIP_SPACES(cp);
+    if (*cp != ']')
+        return -1;
+    s->cp = cp + 1;
+    return 0;
+}
+
+/*
+* Return: 0 on success, -1 if the expression is invalid or out of memory.
+*/
+static int xson_query_scan(struct xson_query_scan * s) {
+    char    *cp, *key;
+    int     first = 1;
+
+    if (*s->cp == '$') {
+        ++s->cp;
+        first = 0;
+    }
+
+    for (; *s->cp; first = 0) {
+        cp = s->cp;
+        if (cp[0] == '.' && cp[1] == '.') {
+            xson_query_add_op(s, XSON_QUERY_DESCEND);
+            cp += 2;
+            if (*cp == '[') {
+                s->cp = cp;
+                continue;
+            }
+        } else if (*cp == '.') {
+            ++cp;
+        } else if (*cp == '[') {
+            if (xson_query_scan_bracket(s) < 0)
+                return -1;
+            continue;
+        } else if (!first) {
+            return -1;
+        }
+
+        /* a key, or '*' */
+        if (*cp == '*') {
+            xson_query_add_op(s, XSON_QUERY_WILDCARD);
+            s->cp = cp + 1;
+            continue;
+        }
+        for (key = cp; *cp && *cp != '.' && *cp != '['; ++cp)
+            ;
+        if (cp == key)
+            return -1;
+        xson_query_add_key(s, key, cp - key);
+        s->cp = cp;
+    }
+    return 0;
+}
+
+struct xson_query * xson_query_compile(const char * expr) {
+    return xson_query_compile_with_allocator(expr, &xmpool_default_allocator);
+}
+
+struct xson_query *
+xson_query_compile_with_allocator(const char * expr,
+                                  const struct xmpool_allocator_t * allocator) {
+    struct xson_query_scan  s;
+    struct xson_query       *query;
+    char                    *copy;
+    size_t                  len;
+    int                     n_ops, n_filters;
+    assert(expr != NULL);
+    assert(allocator != NULL);
+
+    if (expr == NULL || allocator == NULL)
+        return NULL;
+
+    memset(&s, 0, sizeof(s));
+    s.cp = (char *)expr;
+    if (xson_query_scan(&s) < 0)
+        return NULL;
+    n_ops = s.n_ops;
+    n_filters = s.n_filters;
+
+    len = strlen(expr) + 1;
+    query = XM_ALLOC(allocator, sizeof(struct xson_query) +
+                     n_ops * sizeof(struct xson_query_op) +
+                     n_filters * sizeof(struct xson_query_filter) + len);
+    if (query == NULL)
+        return NULL;
+    query->n_ops = 0;
+    query->ops = (struct xson_query_op *)(query + 1);
+    query->allocator = allocator;
+    copy = (char *)((struct xson_query_filter *)(query->ops + n_ops) +
+                    n_filters);
+    memcpy(copy, expr, len);
+
+    memset(&s, 0, sizeof(s));
+    s.cp = copy;
+    s.query = query;
+    s.filters = (struct xson_query_filter *)(query->ops + n_ops);
+    s.allocator = allocator;
+    if (xson_query_scan(&s) < 0) {
+        xson_query_free(query);
+        return NULL;
+    }
+    assert(s.n_ops == n_ops && s.n_filters == n_filters);
+
+    return query;
+}
+
+/* a step of the plan in progress */
+struct xson_query_frame {
+    struct xson_element *elt;
+    /* the operation applied to @elt */
+    int                 op;
+    /* the cursor over the children of @elt */
+    long                pos, end;
+};
+
+static inline int xson_query_n_children(struct xson_element * elt) {
+    if (elt->type == ELE_TYPE_OBJECT)
+        return elt->u.object->idx;
+    else if (elt->type == ELE_TYPE_ARRAY)
+        return elt->u.array->idx;
+    return 0;
+}
+
+static inline struct xson_element *
+xson_query_child(struct xson_element * elt, int i) {
+    if (elt->type == ELE_TYPE_OBJECT)
+        return elt->u.object->values[i];
+    return elt->u.array->array[i];
+}
+
+/*
+* Resolve the bounds of a slice of an array of @n elements
+* the way Python does.
+*/
+static void xson_query_slice(const struct xson_query_op * op, int n,
+                             long * start, long * end) {
+    long    s, e, lo = op->step > 0 ? 0 : -1, hi = op->step > 0 ? n : n - 1;
+
+    if (op->step > 0) {
+        s = op->has_start ? op->start : 0;
+        e = op->has_end ? op->end : n;
+    } else {
+        s = op->has_start ? op->start : n - 1;
+        e = op->has_end ? op->end : -1L - n;
+    }
+    if (s < 0)
+        s += n;
+    if (e < 0)
+        e += n;
+    *start = s < lo ? lo : s > hi ? hi : s;
+    *end = e < lo ? lo : e > hi ? hi : e;
+}
+
+static void xson_query_enter(const struct xson_query * query,
+                             struct xson_query_frame * frame,
+                             struct xson_element * elt, int op) {
+    const struct xson_query_op *o = &query->ops[op];
+
+    frame->elt = elt;
+    frame->op = op;
+    frame->pos = 0;
+    frame->end = xson_query_n_children(elt);
+    switch (o->type) {
+    case XSON_QUERY_KEY:
+        frame->end = elt->type == ELE_TYPE_OBJECT;
+        break;
+    case XSON_QUERY_INDEX:
+        frame->end = elt->type == ELE_TYPE_ARRAY;
+        break;
+    case XSON_QUERY_SLICE:
+        if (elt->type == ELE_TYPE_ARRAY)
+            xson_query_slice(o, frame->end, &frame->pos, &frame->end);
+        else
+            frame->end = 0;
+        break;
+    case XSON_QUERY_DESCEND:
+        frame->pos = -1;
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+* Return: 1 if @elt passes the test of @f, 0 otherwise.
+*/
+static int xson_query_test(const struct xson_query_filter * f,
+                           struct xson_element * elt) {
+    double  d;
+    size_t  len;
+    int     c;
+
+    if (f->path)
+        elt = xson_path_eval(elt, f->path);
+    if (!XSON_GOOD_ELEMENT(elt))
+        return 0;
+    if (f->cmp == XSON_QUERY_EXISTS)
+        return 1;
+    if (elt->type != f->type)
+        return f->cmp == XSON_QUERY_NE;
+
+    switch (f->type) {
+    case ELE_TYPE_NUMBER:
+        if (xson_number_to_double(&elt->u.number, &d) != XSON_RESULT_SUCCESS)
+            return 0;
+        c = d < f->number ? -1 : d > f->number;
+        break;
+    case ELE_TYPE_STRING:
+        len = elt->u.string.end + 1 - elt->u.string.start;
+        c = memcmp(elt->u.string.start, f->string, len < f->len ? len : f->len);
+        if (c == 0)
+            c = len < f->len ? -1 : len > f->len;
+        break;
+    case ELE_TYPE_BOOL:
+        c = elt->u.xbool.bool_val - f->xbool;
+        break;
+    default:
+        c = 0;
+        break;
+    }
+
+    switch (f->cmp) {
+    case XSON_QUERY_EQ: return c == 0;
+    case XSON_QUERY_NE: return c != 0;
+    case XSON_QUERY_LT: return c < 0;
+    case XSON_QUERY_LE: return c <= 0;
+    case XSON_QUERY_GT: return c > 0;
+    case XSON_QUERY_GE: return c >= 0;
+    default: return 1;
+    }
+}
+
+/*
+* Advance @frame to the next element its operation selects.
+* Return: the element, NULL if there is no more.
+* @descend: set if the element is a descendant the same operation
+*           applies to, rather than a match for the next operation.
+*/
+static struct xson_element *
+xson_query_next(const struct xson_query * query,
+                struct xson_query_frame * frame, int * descend) {
+    const struct xson_query_op  *o = &query->ops[frame->op];
+    struct xson_object          *obj;
+    struct xson_array           *array;
+    struct xson_element         *child;
+    long                        i;
+
+    *descend = 0;
+    switch (o->type) {
+    case XSON_QUERY_KEY:
+        if (frame->pos >= frame->end)
+            return NULL;
+        frame->pos = frame->end;
+        obj = frame->elt->u.object;
+        i = xson_pair_ht_retrieve(&obj->ht, obj->keys, o->key, o->len,
+                                  o->hash);
+        return i < 0 ? NULL : obj->values[i];
+    case XSON_QUERY_INDEX:
+        if (frame->pos >= frame->end)
+            return NULL;
+        frame->pos = frame->end;
+        array = frame->elt->u.array;
+        i = o->start < 0 ? (long)o->start + array->idx : o->start;
+        return i >= 0 && i < array->idx ? array->array[i] : NULL;
+    case XSON_QUERY_SLICE:
+        if (o->step > 0 ? frame->pos >= frame->end : frame->pos <= frame->end)
+            return NULL;
+        i = frame->pos;
+        frame->pos += o->step;
+        return frame->elt->u.array->array[i];
+    case XSON_QUERY_WILDCARD:
+        if (frame->pos >= frame->end)
+            return NULL;
+        return xson_query_child(frame->elt, frame->pos++);
+    case XSON_QUERY_FILTER:
+        while (frame->pos < frame->end) {
+            child = xson_query_child(frame->elt, frame->pos++);
+            if (xson_query_test(o->filter, child))
+                return child;
+        }
+        return NULL;
+    case XSON_QUERY_DESCEND:
+        if (frame->pos < 0) {
+            frame->pos = 0;
+            return frame->elt;
+        }
+        while (frame->pos < frame->end) {
+            child = xson_query_child(frame->elt, frame->pos++);
+            if (child->type == ELE_TYPE_OBJECT ||
+                child->type == ELE_TYPE_ARRAY) {
+                *descend = 1;
+                return child;
+            }
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+int xson_query_exec(struct xson_element * elt, const struct xson_query * query,
+                    xson_query_fn fn, void * arg) {
+    struct xson_query_frame         local[XSON_VISIT_STACK_DEPTH];
+    struct xson_query_frame         *stack = local, *frame, *bigger;
+    struct xson_element             *match;
+    int                             top, len, op, descend, rc;
+    assert(elt != NULL);
+    assert(query != NULL);
+    assert(fn != NULL);
+
+    if (elt == NULL || query == NULL || fn == NULL)
+        return XSON_RESULT_ERROR;
+    if (elt->type == ELE_TYPE_ROOT && (elt = elt->u.value.child) == NULL)
+        return XSON_RESULT_SUCCESS;
+    if (query->n_ops == 0)
+        return fn(elt, arg) == XSON_VISIT_STOP ?
+               XSON_VISIT_STOP : XSON_RESULT_SUCCESS;
+
+    len = XSON_VISIT_STACK_DEPTH;
+    xson_query_enter(query, &stack[0], elt, 0);
+    top = 1;
+
+    rc = XSON_RESULT_SUCCESS;
+    while (top > 0) {
+        frame = &stack[top - 1];
+        if ((match = xson_query_next(query, frame, &descend)) == NULL) {
+            --top;
+            continue;
+        }
+
+        op = descend ? frame->op : frame->op + 1;
+        if (op == query->n_ops) {
+            if (fn(match, arg) == XSON_VISIT_STOP) {
+                rc = XSON_VISIT_STOP;
+                break;
+            }
+            continue;
+        }
+        if (top == len) {
+            bigger = XM_ALLOC(query->allocator, 2 * len * sizeof(*stack));
+            if (bigger == NULL) {
+                rc = XSON_RESULT_OOM;
+                break;
+            }
+            memcpy(bigger, stack, len * sizeof(*stack));
+            if (stack != local)
+                XM_FREE(query->allocator, stack);
+            stack = bigger;
+            len *= 2;
+        }
+        xson_query_enter(query, &stack[top++], match, op);
+    }
+
+    if (stack != local)
+        XM_FREE(query->allocator, stack);
+    return rc;
+}
+
+void xson_query_free(struct xson_query * query) {
+    int i;
+
+    if (query == NULL)
+        return;
+    for (i = 0; i < query->n_ops; ++i)
+        if (query->ops[i].filter && query->ops[i].filter->path)
+            xson_path_free(query->ops[i].filter->path);
+    XM_FREE(query->allocator, query);
+}
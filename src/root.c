@@ -24,70 +24,45 @@
 #include "xson/types.h"
 #include "xson/parser.h"
 
-static int xson_root_initialize(struct xson_element * e,
+static int xson_root_initialize(struct xson_context * ctx,
+                                struct xson_element * e,
                                 struct xson_lex_element * lex) {
-    struct xson_value * val = xson_malloc(&e->ctx->pool,
-                                          sizeof(struct xson_value));
-    if (val == NULL) {
-        return XSON_RESULT_OOM;
-    }
+    struct xson_value * val = &e->u.value;
+
     val->child = NULL;
-    e->internal = val;
+    val->ctx = ctx;
 
     return XSON_RESULT_SUCCESS;
 }
-static void xson_root_destroy(struct xson_element * ele) {
-    struct xson_value * val = ele->internal;
-    val->child->ops->destroy(val->child);
-}
-
 /*
 * if root element holds a array, access it like "[n]".
 * Otherwise root element holds a object element, access
 * it as normal object element.
 */
 static struct xson_element *
-xson_root_get_child(struct xson_element * ele, const char * expr) {
+xson_root_get_child(struct xson_element * ele, const char * expr,
+                    size_t len) {
     assert(ele != NULL);
-    assert(ele->internal != NULL);
     struct xson_value   *val;
-    struct xson_element *child, *ret;
-    char                *buf;
+    struct xson_element *child;
     if (ele == NULL)
         return XSON_EXPR_NULL;
     
-    val = ele->internal;
+    val = &ele->u.value;
 
-    if (val == NULL)
-        return XSON_EXPR_NULL;
-    
     child = xson_value_get_elt(val);
 
     if (child == NULL)
         return XSON_EXPR_NULL;
 
     /* handle the case that the epxression start with '[i].key1.key2...' */
-    if (child->type == ELE_TYPE_ARRAY && expr[0] == '[') {
-        buf = malloc(strlen(expr) + 2); /* 1 for ' ', 1 for '\0' */
-
-        if (buf == NULL)
-            return XSON_EXPR_OOM;
-
-        buf[0] = ' ';
-        strcpy(buf + 1, expr);
-
-        ret = child->ops->get_child(child, buf);
-
-        free(buf);
-
-        return ret;
-    }
-    return child->ops->get_child(child, expr);
+    /* the array takes the empty key */
+    return XSON_OPS(child)->get_child(child, expr, len);
 }
 
 static int xson_root_add_child(struct xson_element * parent,
                                struct xson_element * child) {
-    struct xson_value * val = (struct xson_value *)parent->internal;
+    struct xson_value * val = &parent->u.value;
     if (child->type != ELE_TYPE_OBJECT &&
        child->type != ELE_TYPE_ARRAY) {
         printf("Child type for root element must be one of: object, pair.\n");
@@ -97,21 +72,40 @@ static int xson_root_add_child(struct xson_element * parent,
         return XSON_RESULT_INVALID_JSON;
     }
     val->child = child;
-    child->parent = parent;
+    ++val->ctx->generation;
+    XSON_SET_PARENT(child, parent);
     return XSON_RESULT_SUCCESS;
 }
 static void xson_root_print(struct xson_element * ele, int level, int indent,
                             int dont_pad_on_first_line) {
-    struct xson_value * val = ele->internal;
-    val->child->ops->print(val->child, level, indent, 0);
+    struct xson_value * val = &ele->u.value;
+    XSON_OPS(val->child)->print(val->child, level, indent, 0);
     XSON_PADDING_PRINT(level * indent, "\n");
 }
+static int xson_root_freeze(struct xson_element * ele) {
+    struct xson_value * val = &ele->u.value;
+
+    if (val->child == NULL)
+        return XSON_RESULT_SUCCESS;
+    return XSON_OPS(val->child)->freeze(val->child);
+}
+
+static void xson_root_destroy(struct xson_context * ctx,
+                              struct xson_element * ele) {
+    struct xson_value   *val = &ele->u.value;
+
+    if (val->child)
+        xson_element_destroy(ctx, val->child);
+    val->child = NULL;
+}
+
 struct xson_ele_operations root_ops =  {
     xson_root_initialize,
-    xson_root_destroy,
     xson_root_get_child,
     xson_root_add_child,
-    xson_root_print
+    xson_root_print,
+    xson_root_freeze,
+    xson_root_destroy
 };
 
 struct xson_element* xson_value_get_elt(struct xson_value * val){
@@ -24,24 +24,19 @@
 #include "xson/types.h"
 #include "xson/parser.h"
 
-static int xson_string_initialize(struct xson_element * e,
+static int xson_string_initialize(struct xson_context * ctx,
+                                  struct xson_element * e,
                                   struct xson_lex_element * lex) {
-    struct xson_string *string;
-    if ((e->internal = xson_malloc(&e->ctx->pool, sizeof(struct xson_string))) == NULL) {
-        return XSON_RESULT_OOM;
-    }
-    string = (struct xson_string *)e->internal;
+    struct xson_string *string = &e->u.string;
+
     string->start = lex->start;
     string->end = lex->end;
     return XSON_RESULT_SUCCESS;
 }
 
-static void xson_string_destroy(struct xson_element * ele) {
-    ;
-}
-
 static struct xson_element *
-xson_string_get_child(struct xson_element * ele, const char * expr) {
+xson_string_get_child(struct xson_element * ele, const char * expr,
+                      size_t len) {
     return XSON_EXPR_OP_NOTSUPPORTED;
 }
 
@@ -53,20 +48,27 @@ static int xson_string_add_child(struct xson_element * parent,
 
 static void xson_string_print(struct xson_element * ele, int level, int indent,
                               int dont_pad_on_first_line) {
-    struct xson_string  *string = ele->internal;
-    char                t = *(string->end + 1);
+    struct xson_string  *string = &ele->u.string;
+
+    XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent), "\"%.*s\"",
+                       (int)(string->end + 1 - string->start), string->start);
+}
+
+static int xson_string_freeze(struct xson_element * ele) {
+    return XSON_RESULT_SUCCESS;
+}
 
-    *(string->end + 1) = 0;
-    XSON_PADDING_PRINT((dont_pad_on_first_line ? 0 : level * indent), "\"%s\"", string->start);
-    *(string->end + 1) = t;
+static void xson_string_destroy(struct xson_context * ctx,
+                                struct xson_element * ele) {
 }
 
 struct xson_ele_operations string_ops =  {
     xson_string_initialize,
-    xson_string_destroy,
     xson_string_get_child,
     xson_string_add_child,
-    xson_string_print
+    xson_string_print,
+    xson_string_freeze,
+    xson_string_destroy
 };
 
 int xson_string_to_buf(struct xson_string * string, char * buf, size_t len){
@@ -23,115 +23,284 @@
 
 /* definitions of some utility functions in types.h */
 #include <assert.h>
+#include <limits.h>
 
 #include "xson/types.h"
 #include "xson/parser.h"
 
-int xson_is_array_expression(const char * expr) {
-    int         idx, ret;
-    static char trailing[1];
-
-    trailing[0] = 0;
+int xson_parse_array_expression(const char * expr, size_t len,
+                                size_t * keylen, int * idx) {
+    const char  *cp, *end = expr + len;
+    int         neg = 0;
+    long long   v = 0;
+
+    if ((cp = memchr(expr, '[', len)) == NULL)
+        return 0;
+    *keylen = cp++ - expr;
+    if (cp < end && *cp == '-') {
+        neg = 1;
+        ++cp;
+    }
+    if (cp == end || *cp < '0' || *cp > '9')
+        return 0;
+    for (; cp < end && *cp >= '0' && *cp <= '9'; ++cp)
+        if (v <= INT_MAX)
+            v = v * 10 + (*cp - '0');
+    if (cp + 1 != end || *cp != ']')
+        return 0;
+
+    *idx = v > INT_MAX ? INT_MAX : neg ? (int)-v : (int)v;
+    return 1;
+}
 
-    ret = sscanf(expr, "%*[^[][%d]%1s", &idx, trailing);
+int xson_is_array_expression(const char * expr) {
+    size_t  keylen;
+    int     idx;
 
-    return ret == 1;
+    return xson_parse_array_expression(expr, strlen(expr), &keylen, &idx) &&
+           keylen > 0;
 }
 
 struct xson_string * xson_elt_to_string(struct xson_element * elt) {
     assert(elt != NULL);
-    assert(elt->internal != NULL);
 
     if (elt == NULL || elt->type != ELE_TYPE_STRING) 
         return NULL;
 
-    return (struct xson_string *)elt->internal;
+    return &elt->u.string;
 }
 
 struct xson_number * xson_elt_to_number(struct xson_element * elt) {
     assert(elt != NULL);
-    assert(elt->internal != NULL);
     
     if (elt == NULL || elt->type != ELE_TYPE_NUMBER) 
         return NULL;
 
-    return (struct xson_number *)elt->internal;
+    return &elt->u.number;
 }
 
 struct xson_value * xson_elt_to_value(struct xson_element * elt) {
     assert(elt != NULL);
-    assert(elt->internal != NULL);
 
     if (elt == NULL ||
         (elt->type != ELE_TYPE_VALUE && elt->type != ELE_TYPE_ROOT))
         return NULL;
 
-    return (struct xson_value *)elt->internal;
+    return &elt->u.value;
 }
 
 struct xson_array * xson_elt_to_array(struct xson_element * elt) {
     assert(elt != NULL);
-    assert(elt->internal != NULL);
 
     if (elt == NULL || elt->type != ELE_TYPE_ARRAY) 
         return NULL;
 
-    return (struct xson_array *)elt->internal;
+    return elt->u.array;
 }
 
 struct xson_object * xson_elt_to_object(struct xson_element * elt) {
     assert(elt != NULL);
-    assert(elt->internal != NULL);
 
     if (elt == NULL || elt->type != ELE_TYPE_OBJECT)
         return NULL;
 
-    return (struct xson_object *)elt->internal;
+    return elt->u.object;
 }
 
-struct xson_pair * xson_elt_to_pair(struct xson_element * elt) {
+void xson_element_destroy(struct xson_context * ctx, struct xson_element * elt) {
+    assert(ctx != NULL);
     assert(elt != NULL);
-    assert(elt->internal != NULL);
 
-    if (elt == NULL || elt->type != ELE_TYPE_PAIR)
+    XSON_OPS(elt)->destroy(ctx, elt);
+    xmpool_free(&ctx->pool, elt, sizeof(struct xson_element));
+}
+
+/*
+* Nodes do not point back to their context, containers do.
+* Return: the context @elt belongs to, NULL if @elt is a leaf.
+*/
+static struct xson_context * xson_element_context(struct xson_element * elt) {
+    switch (elt->type) {
+    case ELE_TYPE_ROOT:
+        return elt->u.value.ctx;
+    case ELE_TYPE_OBJECT:
+        return elt->u.object->ctx;
+    case ELE_TYPE_ARRAY:
+        return elt->u.array->ctx;
+    default:
         return NULL;
+    }
+}
+
+/*
+* Return: the allocator of the context @elt belongs to,
+*         the default allocator if @elt is a leaf.
+*/
+static const struct xmpool_allocator_t *
+xson_element_allocator(struct xson_element * elt) {
+    struct xson_context *ctx = xson_element_context(elt);
 
-    return (struct xson_pair *)elt->internal;
+    return ctx ? ctx->pool.allocator : &xmpool_default_allocator;
 }
 
+static struct xson_element *
+xson_resolve_expr(struct xson_element * elt, const char * key) {
+    const char *p, *end;
+
+    for (p = key; ; p = end + 1) {
+        for (end = p; *end && *end != '.'; ++end)
+            ;
+        if (end > p) {
+            elt = XSON_OPS(elt)->get_child(elt, p, end - p);
+            if (!XSON_GOOD_ELEMENT(elt))
+                break;
+        }
+        if (*end == '\0')
+            break;
+    }
+    
+    return elt;
+}
+
+/*
+* Resolve @key through the lookup cache of @ctx, only the expressions
+* leading to an element are remembered.
+*/
+static struct xson_element *
+xson_lookup_cache_get(struct xson_context * ctx, struct xson_element * elt,
+                      const char * key) {
+    struct xson_lookup_entry    *entry;
+    struct xson_element         *result;
+    size_t                      len = strlen(key);
+    unsigned                    hash;
+
+    if (len > XSON_LOOKUP_CACHE_EXPR_MAX)
+        return xson_resolve_expr(elt, key);
+
+    hash = xson_pair_ht_hash(key, len);
+    entry = &ctx->cache[hash & (ctx->cache_len - 1)];
+    if (entry->generation == ctx->generation && entry->from == elt &&
+        entry->hash == hash && entry->len == len &&
+        memcmp(entry->expr, key, len) == 0)
+        return entry->result;
+
+    result = xson_resolve_expr(elt, key);
+    if (XSON_GOOD_ELEMENT(result)) {
+        entry->from = elt;
+        entry->result = result;
+        entry->generation = ctx->generation;
+        entry->hash = hash;
+        entry->len = len;
+        memcpy(entry->expr, key, len);
+    }
+    return result;
+}
 
 struct xson_element *
 xson_get_by_expr(struct xson_element * elt, const char * key) {
     assert(elt != NULL);
     assert(key != NULL);
-    char *p;
-    char *buf;
+    struct xson_context *ctx;
 
     if (elt == NULL || key == NULL)
         return XSON_EXPR_NULL;
 
-    buf = malloc(strlen(key) + 1);
+    ctx = xson_element_context(elt);
+    if (ctx && ctx->cache)
+        return xson_lookup_cache_get(ctx, elt, key);
+    return xson_resolve_expr(elt, key);
+}
 
-    if (buf == NULL)
-        return XSON_EXPR_OOM;
+/* a container being walked by xson_visit() */
+struct xson_visit_frame {
+    struct xson_element * ele;
+    union {
+        struct xson_object_iter obj;
+        struct xson_array_iter array;
+    }it;
+};
 
-    strcpy(buf, key);
+/*
+* Start walking the children of @ele in @frame.
+* Return: 1 if @ele has children to walk, 0 otherwise.
+*/
+static int xson_visit_enter(struct xson_visit_frame * frame,
+                            struct xson_element * ele) {
+    frame->ele = ele;
+    if (ele->type == ELE_TYPE_OBJECT && ele->u.object->idx > 0) {
+        xson_object_iter_init(&frame->it.obj, ele->u.object);
+        return 1;
+    } else if (ele->type == ELE_TYPE_ARRAY && ele->u.array->idx > 0) {
+        xson_array_iter_init(&frame->it.array, ele->u.array);
+        return 1;
+    }
+    return 0;
+}
 
-    p = strtok(buf, ".");
+int xson_visit(struct xson_element * elt, xson_visit_fn fn, void * arg) {
+    struct xson_visit_frame         local[XSON_VISIT_STACK_DEPTH];
+    struct xson_visit_frame         *stack = local, *frame, *bigger;
+    struct xson_element             *child;
+    const char                      *key;
+    size_t                          keylen;
+    int                             top, len, rc, more;
+    const struct xmpool_allocator_t *allocator;
+    assert(elt != NULL);
+    assert(fn != NULL);
 
-    while (p) {
-        elt = elt->ops->get_child(elt, p);
-        if (!XSON_GOOD_ELEMENT(elt))
+    if (elt == NULL || fn == NULL)
+        return XSON_RESULT_ERROR;
+    allocator = xson_element_allocator(elt);
+    if (elt->type == ELE_TYPE_ROOT && (elt = elt->u.value.child) == NULL)
+        return XSON_RESULT_SUCCESS;
+
+    if ((rc = fn(elt, NULL, 0, 0, arg)) == XSON_VISIT_STOP)
+        return XSON_VISIT_STOP;
+    len = XSON_VISIT_STACK_DEPTH;
+    top = rc == XSON_VISIT_CONTINUE && xson_visit_enter(&stack[0], elt);
+
+    rc = XSON_RESULT_SUCCESS;
+    while (top > 0) {
+        frame = &stack[top - 1];
+        key = NULL;
+        keylen = 0;
+        if (frame->ele->type == ELE_TYPE_OBJECT)
+            more = xson_object_iter_next(&frame->it.obj, &key, &keylen, &child);
+        else
+            more = xson_array_iter_next(&frame->it.array, &child);
+        if (!more) {
+            --top;
+            continue;
+        }
+
+        if ((rc = fn(child, key, keylen, top, arg)) == XSON_VISIT_STOP)
             break;
-        p = strtok(NULL, ".");
+        more = rc != XSON_VISIT_SKIP;
+        rc = XSON_RESULT_SUCCESS;
+        if (!more)
+            continue;
+        if (top == len) {
+            /* nested deeper than the stack on hand */
+            bigger = XM_ALLOC(allocator, 2 * len * sizeof(*stack));
+            if (bigger == NULL) {
+                rc = XSON_RESULT_OOM;
+                break;
+            }
+            memcpy(bigger, stack, len * sizeof(*stack));
+            if (stack != local)
+                XM_FREE(allocator, stack);
+            stack = bigger;
+            len *= 2;
+        }
+        top += xson_visit_enter(&stack[top], child);
     }
 
-    free(buf);
-    
-    return elt;
+    if (stack != local)
+        XM_FREE(allocator, stack);
+    return rc;
 }
 
-static int xson_convert_expr_res_to_res(struct xson_element * elt) {
+int xson_convert_expr_res_to_res(struct xson_element * elt) {
     if (elt == XSON_EXPR_NULL)
         return XSON_RESULT_ERROR;
     else if(elt == XSON_EXPR_OOM)
@@ -144,10 +313,33 @@ static int xson_convert_expr_res_to_res(struct xson_element * elt) {
         return XSON_RESULT_OP_NOTSUPPORTED;
     else if(elt == XSON_EXPR_INVALID_EXPR)
         return XSON_RESULT_INVALID_EXPR;
+    else if(elt == XSON_EXPR_TYPE_MISMATCH)
+        return XSON_RESULT_TYPE_MISMATCH;
 
     return XSON_RESULT_SUCCESS;
 }
 
+/*
+* Check the result of xson_get_by_expr() and the type of the element.
+* Numbers and strings are both spans of the text, so either can be read
+* as the other.
+* Return: XSON_RESULT_SUCCESS if @elt can be read as @type, the error
+*         of xson_convert_expr_res_to_res() or XSON_RESULT_TYPE_MISMATCH.
+*/
+static int xson_expr_res_check(struct xson_element * elt,
+                               enum xson_ele_type type) {
+    int rc;
+
+    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+        return rc;
+    if (elt->type == type)
+        return XSON_RESULT_SUCCESS;
+    if ((type == ELE_TYPE_NUMBER || type == ELE_TYPE_STRING) &&
+        (elt->type == ELE_TYPE_NUMBER || elt->type == ELE_TYPE_STRING))
+        return XSON_RESULT_SUCCESS;
+    return XSON_RESULT_TYPE_MISMATCH;
+}
+
 int xson_get_ull_by_expr(struct xson_element * elt, const char * expr,
                          unsigned long long *out) {
     int                  rc;
@@ -155,10 +347,11 @@ int xson_get_ull_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_ullong(number, out);
 }
@@ -170,10 +363,11 @@ int xson_get_llong_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_llong(number, out);
 }
@@ -185,10 +379,11 @@ int xson_get_ulong_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_ulong(number, out);
 }
@@ -200,10 +395,11 @@ int xson_get_long_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_long(number, out);
 }
@@ -215,10 +411,11 @@ int xson_get_uint_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_uint(number, out);
 }
@@ -230,10 +427,11 @@ int xson_get_int_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_int(number, out);
 }
@@ -245,10 +443,11 @@ int xson_get_intptr_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_intptr(number, out);
 }
@@ -259,10 +458,11 @@ int xson_get_bool_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_BOOL)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    xbool = elt->internal;
+    xbool = &elt->u.xbool;
 
     return xson_bool_to_int(xbool, out);
 }
@@ -273,10 +473,11 @@ int xson_get_double_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_double(number, out);
 }
@@ -288,10 +489,11 @@ int xson_get_float_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_NUMBER)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    number = elt->internal;
+    number = &elt->u.number;
 
     return xson_number_to_float(number, out);
 }
@@ -304,10 +506,11 @@ int xson_get_string_by_expr(struct xson_element * elt, const char * expr,
 
     elt = xson_get_by_expr(elt, expr);
 
-    if ((rc = xson_convert_expr_res_to_res(elt)) != XSON_RESULT_SUCCESS)
+    if ((rc = xson_expr_res_check(elt, ELE_TYPE_STRING)) !=
+        XSON_RESULT_SUCCESS)
         return rc;
 
-    string = elt->internal;
+    string = &elt->u.string;
 
     return xson_string_to_buf(string, buf, size);
 }
@@ -324,7 +527,7 @@ struct xson_array * xson_get_array_by_expr(struct xson_element * elt,
     if (elt->type != ELE_TYPE_ARRAY)
         return NULL;
 
-    return (struct xson_array *)elt->internal;
+    return elt->u.array;
 }
 
 struct xson_object * xson_get_object_by_expr(struct xson_element * elt,
@@ -339,7 +542,7 @@ struct xson_object * xson_get_object_by_expr(struct xson_element * elt,
     if (elt->type != ELE_TYPE_OBJECT)
         return NULL;
 
-    return (struct xson_object *)elt->internal;
+    return elt->u.object;
 }
 
 int xson_get_arraysize_by_expr(struct xson_element * elt,
@@ -354,7 +557,7 @@ int xson_get_arraysize_by_expr(struct xson_element * elt,
     if (elt->type != ELE_TYPE_ARRAY)
         return XSON_RESULT_TYPE_MISMATCH;
 
-    return xson_array_get_size((struct xson_array *)elt->internal);
+    return xson_array_get_size(elt->u.array);
 }
 
 
@@ -371,7 +574,7 @@ int xson_get_stringsize_by_expr(struct xson_element * elt,
     if (elt->type != ELE_TYPE_STRING)
         return XSON_RESULT_TYPE_MISMATCH;
 
-    string = (struct xson_string *)elt->internal;
+    string = &elt->u.string;
 
     return string->end - string->start + 1;
 }
\ No newline at end of file
@@ -21,132 +21,628 @@
 * DATA, OR PROFITS; OR BUSINESS INTERR
 */
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "xson/xmalloc.h"
 
-static struct xmpool_chunk_t *
-xmpool_chunk_alloc_init(size_t chunk_size) {
-    struct xmpool_chunk_t * chunk = malloc(sizeof(struct xmpool_chunk_t));
+/* the chunk header sits right before the memory it manages */
+#define XM_CHUNK_HEADER_SIZE \
+    XM_ALIGN(sizeof(struct xmpool_chunk_t), XM_ALIGNMENT)
+#define XM_LARGE_HEADER_SIZE \
+    XM_ALIGN(sizeof(struct xmpool_large_chunk_t), XM_ALIGNMENT)
 
-    if (chunk == NULL) {
-        assert(0);
+#define XM_CHUNK_FREE_SIZE(c) ((c)->size - ((size_t)((c)->first - (c)->smem)))
+
+/* count @n more bytes obtained by @pool */
+#define XM_ACCOUNT(pool, n) do {                        \
+        (pool)->bytes += (n);                           \
+        if ((pool)->bytes > (pool)->peak_bytes)         \
+            (pool)->peak_bytes = (pool)->bytes;         \
+    } while (0)
+
+static void * xmpool_default_alloc(void * user, size_t size) {
+    return malloc(size);
+}
+
+static void * xmpool_default_realloc(void * user, void * ptr, size_t size) {
+    return realloc(ptr, size);
+}
+
+static void xmpool_default_free(void * user, void * ptr) {
+    free(ptr);
+}
+
+const struct xmpool_allocator_t xmpool_default_allocator = {
+    xmpool_default_alloc,
+    xmpool_default_realloc,
+    xmpool_default_free,
+    NULL
+};
+
+/*
+* The chunk recycler keeps the chunks of destroyed pools for the pools
+* created later, one class per chunk size from XM_CHUNK_SIZE up to
+* XM_MAX_CHUNK_SIZE. Every thread caches up to XM_MAGAZINE_SIZE chunks of
+* each class in its magazine, which needs no synchronization at all;
+* the rest goes to a lock-free global list per class.
+* Chunks are linked through chunk_link.next, NULL terminated.
+* The global lists are only pushed to one chunk at a time and emptied
+* at once with an atomic exchange, so that no pop can be fooled by a
+* chunk popped and pushed again behind its back (the ABA problem).
+*/
+#define XM_RECYCLER_CLASSES 9
+#define XM_MAGAZINE_SIZE 8
+
+typedef struct xmpool_magazine_t {
+    struct xmpool_chunk_t * chunks[XM_MAGAZINE_SIZE];
+    int n;
+}xmpool_magazine_t;
+
+static struct {
+    /* most bytes kept on the global lists, 0 if recycling is disabled */
+    size_t max_bytes;
+    /* bytes kept on the global lists */
+    size_t bytes;
+    struct list_head * lists[XM_RECYCLER_CLASSES];
+}xm_recycler;
+
+static __thread struct xmpool_magazine_t xm_magazines[XM_RECYCLER_CLASSES];
+static __thread int xm_magazines_registered;
+static pthread_key_t xm_magazine_key;
+static pthread_once_t xm_magazine_once = PTHREAD_ONCE_INIT;
+
+#define XM_CHUNK_OF(link) list_entry((link), struct xmpool_chunk_t, chunk_link)
+
+static int xmpool_recycler_class(size_t size) {
+    int i;
+
+    for (i = 0; i < XM_RECYCLER_CLASSES; ++i) {
+        if (((size_t)XM_CHUNK_SIZE << i) == size)
+            return i;
+    }
+    return -1;
+}
+
+static void xmpool_recycler_push(int cls, struct xmpool_chunk_t * chunk) {
+    struct list_head * head;
+
+    head = __atomic_load_n(&xm_recycler.lists[cls], __ATOMIC_RELAXED);
+    do {
+        chunk->chunk_link.next = head;
+    } while (!__atomic_compare_exchange_n(&xm_recycler.lists[cls], &head,
+                                          &chunk->chunk_link, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+* Put @chunk on the global list of its class unless the cap is reached.
+* Return: 1 if the chunk was taken, 0 otherwise.
+*/
+static int xmpool_recycler_push_capped(int cls, struct xmpool_chunk_t * chunk) {
+    size_t max = __atomic_load_n(&xm_recycler.max_bytes, __ATOMIC_RELAXED);
+
+    if (__atomic_add_fetch(&xm_recycler.bytes, chunk->size,
+                           __ATOMIC_RELAXED) > max) {
+        __atomic_sub_fetch(&xm_recycler.bytes, chunk->size, __ATOMIC_RELAXED);
+        return 0;
+    }
+    xmpool_recycler_push(cls, chunk);
+    return 1;
+}
+
+/* hand the magazines of an exiting thread over to the global lists */
+static void xmpool_magazine_flush(void * arg) {
+    struct xmpool_magazine_t * mags = arg;
+    struct xmpool_chunk_t * chunk;
+    int cls;
+
+    for (cls = 0; cls < XM_RECYCLER_CLASSES; ++cls) {
+        while (mags[cls].n > 0) {
+            chunk = mags[cls].chunks[--mags[cls].n];
+            if (!xmpool_recycler_push_capped(cls, chunk))
+                free(chunk);
+        }
+    }
+}
+
+static void xmpool_magazine_key_init(void) {
+    pthread_key_create(&xm_magazine_key, xmpool_magazine_flush);
+}
+
+/*
+* Have the magazines of the calling thread flushed when it exits,
+* before any chunk is put in them.
+*/
+static void xmpool_magazine_register(void) {
+    if (!xm_magazines_registered) {
+        pthread_once(&xm_magazine_once, xmpool_magazine_key_init);
+        pthread_setspecific(xm_magazine_key, xm_magazines);
+        xm_magazines_registered = 1;
+    }
+}
+
+/*
+* Take a chunk of @size bytes from the recycler.
+* Return: the chunk, NULL if there is none.
+*/
+static struct xmpool_chunk_t * xmpool_recycler_get(size_t size) {
+    struct xmpool_magazine_t * mag;
+    struct list_head * link, * rest, * next;
+    size_t taken;
+    int cls;
+
+    if ((cls = xmpool_recycler_class(size)) == -1)
         return NULL;
+    mag = &xm_magazines[cls];
+    if (mag->n > 0)
+        return mag->chunks[--mag->n];
+
+    /* refill the magazine with the whole global list, return the excess */
+    link = __atomic_exchange_n(&xm_recycler.lists[cls], NULL, __ATOMIC_ACQUIRE);
+    if (link == NULL)
+        return NULL;
+    xmpool_magazine_register();
+    rest = link->next;
+    taken = size;
+    while (rest && mag->n < XM_MAGAZINE_SIZE) {
+        mag->chunks[mag->n++] = XM_CHUNK_OF(rest);
+        rest = rest->next;
+        taken += size;
     }
-    
-    memset(chunk, 0, sizeof(struct xmpool_chunk_t));
-    
-    chunk->smem = malloc(chunk_size);
-    if (chunk->smem == NULL) {
+    __atomic_sub_fetch(&xm_recycler.bytes, taken, __ATOMIC_RELAXED);
+    for (; rest; rest = next) {
+        next = rest->next;
+        xmpool_recycler_push(cls, XM_CHUNK_OF(rest));
+    }
+    return XM_CHUNK_OF(link);
+}
+
+/*
+* Give @chunk back to the recycler.
+* Return: 1 if the chunk was taken, 0 if the caller has to free it.
+*/
+static int xmpool_recycler_put(struct xmpool_chunk_t * chunk) {
+    struct xmpool_magazine_t * mag;
+    int cls;
+
+    if (__atomic_load_n(&xm_recycler.max_bytes, __ATOMIC_RELAXED) == 0 ||
+        (cls = xmpool_recycler_class(chunk->size)) == -1)
+        return 0;
+    xmpool_magazine_register();
+    mag = &xm_magazines[cls];
+    if (mag->n < XM_MAGAZINE_SIZE) {
+        mag->chunks[mag->n++] = chunk;
+        return 1;
+    }
+    return xmpool_recycler_push_capped(cls, chunk);
+}
+
+void xmpool_recycler_enable(size_t max_bytes) {
+    __atomic_store_n(&xm_recycler.max_bytes, max_bytes, __ATOMIC_RELAXED);
+}
+
+void xmpool_recycler_drain(void) {
+    struct list_head * link, * next;
+    int cls;
+
+    xmpool_magazine_flush(xm_magazines);
+    for (cls = 0; cls < XM_RECYCLER_CLASSES; ++cls) {
+        link = __atomic_exchange_n(&xm_recycler.lists[cls], NULL,
+                                   __ATOMIC_ACQUIRE);
+        for (; link; link = next) {
+            next = link->next;
+            __atomic_sub_fetch(&xm_recycler.bytes, XM_CHUNK_OF(link)->size,
+                               __ATOMIC_RELAXED);
+            free(XM_CHUNK_OF(link));
+        }
+    }
+}
+
+/* only the chunks of the default allocator are recycled */
+#define XM_RECYCLES(pool) ((pool)->allocator == &xmpool_default_allocator)
+
+static struct xmpool_chunk_t *
+xmpool_chunk_alloc_init(struct xmpool_t * pool, size_t chunk_size) {
+    struct xmpool_chunk_t * chunk = NULL;
+
+    assert(chunk_size > 0);
+    if (XM_RECYCLES(pool))
+        chunk = xmpool_recycler_get(chunk_size);
+    if (chunk == NULL)
+        chunk = XM_ALLOC(pool->allocator, XM_CHUNK_HEADER_SIZE + chunk_size);
+    if (chunk == NULL) {
         assert(0);
-        free(chunk);
         return NULL;
     }
-    assert(chunk_size > 0);
+
+    chunk->smem = (char *)chunk + XM_CHUNK_HEADER_SIZE;
     chunk->size = chunk_size;
     chunk->first = chunk->smem;
+    XM_ACCOUNT(pool, XM_CHUNK_HEADER_SIZE + chunk_size);
 
     return chunk;
 }
 
 int32_t xmpool_init(struct xmpool_t * pool, size_t chunk_size) {
+    return xmpool_init_with_allocator(pool, chunk_size,
+                                      &xmpool_default_allocator);
+}
+
+int32_t xmpool_init_with_allocator(struct xmpool_t * pool, size_t chunk_size,
+                                   const struct xmpool_allocator_t * allocator) {
     struct xmpool_chunk_t * chunk;
     assert(pool != NULL);
+    assert(allocator != NULL);
     INIT_LIST_HEAD(&pool->chunk_list);
+    INIT_LIST_HEAD(&pool->spare_list);
+    pool->allocator = allocator;
+    pool->arena = NULL;
+    pool->arena_reserved = 0;
+    pool->bytes = 0;
+    pool->peak_bytes = 0;
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    pool->free_bytes = 0;
     pool->chunk_size = chunk_size;
-    pool->chunks = XM_INIT_CHUNKS;
-    chunk = xmpool_chunk_alloc_init(chunk_size);
+    pool->next_chunk_size = chunk_size;
+    pool->large = NULL;
+    pool->floor_chunk = NULL;
+    pool->floor = NULL;
+    pool->floor_large = NULL;
+    chunk = xmpool_chunk_alloc_init(pool, chunk_size);
     if (chunk == NULL)return -1;
     list_add(&chunk->chunk_link, &pool->chunk_list);
+    pool->current = chunk;
+    pool->chunks = 1;
     return 0;
 }
 
+int32_t xmpool_init_arena(struct xmpool_t * pool, size_t reserve, int flags) {
+    struct xmpool_chunk_t * chunk;
+    void * base = MAP_FAILED;
+    assert(pool != NULL);
 
-
-inline static void *
-xmpool_chunk_do_alloc(struct list_head * head,
-                      struct xmpool_chunk_t * chunk, size_t size) {
-    char * res = chunk->first;
-    chunk->first += size;
-    if (res == NULL) {
-        assert(res);
+    reserve = XM_ALIGN(reserve, (size_t)XM_ARENA_COMMIT_MIN);
+    if (reserve == 0)
+        reserve = XM_ARENA_COMMIT_MIN;
+#ifdef MAP_HUGETLB
+    /*
+    * The huge pages are reserved for the whole range up front, the
+    * mapping fails rather than faulting later if there are not enough.
+    */
+    if (flags & XM_ARENA_HUGETLB)
+        base = mmap(NULL, reserve, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (base == MAP_FAILED)
+        base = mmap(NULL, reserve, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        return -1;
+#ifdef MADV_HUGEPAGE
+    if (flags & XM_ARENA_HUGEPAGE)
+        madvise(base, reserve, MADV_HUGEPAGE);
+#endif
+    if (mprotect(base, XM_ARENA_COMMIT_MIN, PROT_READ | PROT_WRITE) == -1) {
+        munmap(base, reserve);
+        return -1;
     }
-    /* move the chunk to the head of the list. */
-    list_del(&chunk->chunk_link);
-    list_add(&chunk->chunk_link, head);
-    
-    
-    return res;
+
+    chunk = base;
+    chunk->smem = (char *)chunk + XM_CHUNK_HEADER_SIZE;
+    chunk->size = XM_ARENA_COMMIT_MIN - XM_CHUNK_HEADER_SIZE;
+    chunk->first = chunk->smem;
+
+    INIT_LIST_HEAD(&pool->chunk_list);
+    INIT_LIST_HEAD(&pool->spare_list);
+    list_add(&chunk->chunk_link, &pool->chunk_list);
+    pool->allocator = &xmpool_default_allocator;
+    pool->arena = chunk;
+    pool->arena_reserved = reserve;
+    pool->bytes = XM_ARENA_COMMIT_MIN;
+    pool->peak_bytes = XM_ARENA_COMMIT_MIN;
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    pool->free_bytes = 0;
+    pool->current = chunk;
+    pool->chunks = 1;
+    pool->chunk_size = XM_CHUNK_SIZE;
+    pool->next_chunk_size = XM_CHUNK_SIZE;
+    pool->large = NULL;
+    pool->floor_chunk = NULL;
+    pool->floor = NULL;
+    pool->floor_large = NULL;
+    return 0;
 }
 
-#define XM_TO_NEXT_POWER_OF_2(n) ( {\
-    int32_t highest_one = 0;\
-    int32_t tmp = (n);\
-    int32_t i = 0;\
-    while (tmp) {\
-        if (tmp & 1) {\
-            highest_one = i;\
-        }\
-        ++i;\
-        tmp >>= 1;\
-    }\
-    (1 << (highest_one + 1));\
-})
+/*
+* Commit more of the arena for an allocation of @size bytes,
+* at least doubling the committed part.
+* Return: 0 on success, -1 if the range is full.
+*/
+static int xmpool_arena_commit(struct xmpool_t * pool, size_t size) {
+    struct xmpool_chunk_t * arena = pool->arena;
+    size_t committed = XM_CHUNK_HEADER_SIZE + arena->size;
+    size_t needed = committed + size - XM_CHUNK_FREE_SIZE(arena);
+    size_t target = committed << 1;
+
+    if (needed > pool->arena_reserved)
+        return -1;
+    if (target < needed)
+        target = XM_ALIGN(needed, (size_t)XM_ARENA_COMMIT_MIN);
+    if (target > pool->arena_reserved)
+        target = pool->arena_reserved;
+    if (mprotect((char *)arena + committed, target - committed,
+                 PROT_READ | PROT_WRITE) == -1)
+        return -1;
+    arena->size = target - XM_CHUNK_HEADER_SIZE;
+    XM_ACCOUNT(pool, target - committed);
+    return 0;
+}
 
 static void *
-xmpool_chunklist_grow_alloc(struct xmpool_t * pool, size_t size) {
-    assert(size > 0);
-    struct xmpool_chunk_t * first_chunk = NULL, *chunk = NULL;
-    int32_t chunks_to_add = 0, i = 0;
-    chunks_to_add = XM_TO_NEXT_POWER_OF_2(pool->chunks) - pool->chunks;
-    assert(chunks_to_add);
-    for (; i < chunks_to_add; ++i) {
-        chunk = xmpool_chunk_alloc_init(pool->chunk_size);
-        if (chunk == NULL)break;
-        list_add(&chunk->chunk_link, &pool->chunk_list);
-        first_chunk = chunk;
-    }
-    pool->chunks += i;
-    if (first_chunk == NULL) {
+xmpool_large_alloc(struct xmpool_t * pool, size_t size) {
+    struct xmpool_large_chunk_t * large;
+
+    large = XM_ALLOC(pool->allocator, XM_LARGE_HEADER_SIZE + size);
+    if (large == NULL) {
         assert(0);
         return NULL;
     }
-    return xmpool_chunk_do_alloc(&pool->chunk_list, first_chunk, size);
+    large->data = (char *)large + XM_LARGE_HEADER_SIZE;
+    large->size = size;
+    large->next = pool->large;
+    XM_ACCOUNT(pool, XM_LARGE_HEADER_SIZE + size);
+    pool->large = large;
+
+    return large->data;
 }
 
-#define XM_CHUNK_FREE_SIZE(c) ((c)->size - ((size_t)((c)->first - (c)->smem)))
+/*
+* The current chunk is exhausted, start a new one twice as large
+* as the previous one, up to XM_MAX_CHUNK_SIZE.
+* The space left in the old chunk is not used anymore.
+*/
+static void *
+xmpool_chunklist_grow_alloc(struct xmpool_t * pool, size_t size) {
+    struct xmpool_chunk_t * chunk;
+    char * res;
+
+    assert(size > 0 && size <= pool->chunk_size);
+    if (!list_empty(&pool->spare_list)) {
+        /* every chunk is at least @pool->chunk_size large */
+        chunk = list_first_entry(&pool->spare_list,
+                                 struct xmpool_chunk_t, chunk_link);
+        list_del(&chunk->chunk_link);
+    } else {
+        if (pool->next_chunk_size < XM_MAX_CHUNK_SIZE)
+            pool->next_chunk_size <<= 1;
+        chunk = xmpool_chunk_alloc_init(pool, pool->next_chunk_size);
+        if (chunk == NULL)
+            return NULL;
+    }
+    list_add(&chunk->chunk_link, &pool->chunk_list);
+    pool->current = chunk;
+    ++pool->chunks;
+
+    res = chunk->first;
+    chunk->first += size;
+    return res;
+}
 
 void * xmpool_alloc(struct xmpool_t * pool, size_t size) {
-    assert(size > 0);
-    struct list_head * p, * head = &pool->chunk_list;
     struct xmpool_chunk_t * chunk;
+    char * res;
     assert(pool != NULL);
+    assert(size > 0);
 
-    if (size > pool->chunk_size)return NULL;
+    size = XM_ALIGN(size, XM_ALIGNMENT);
+
+    if (size <= XM_SMALL_MAX &&
+        (res = pool->free_lists[XM_SMALL_CLASS(size)]) != NULL) {
+        pool->free_lists[XM_SMALL_CLASS(size)] = *(void **)res;
+        pool->free_bytes -= size;
+        return res;
+    }
+
+    chunk = pool->current;
+    if (XM_CHUNK_FREE_SIZE(chunk) >= size) {
+        res = chunk->first;
+        chunk->first += size;
+        return res;
+    }
+
+    if (chunk == pool->arena && xmpool_arena_commit(pool, size) == 0) {
+        res = chunk->first;
+        chunk->first += size;
+        return res;
+    }
+
+    if (size > pool->chunk_size)
+        return xmpool_large_alloc(pool, size);
+
+    return xmpool_chunklist_grow_alloc(pool, size);
+}
+
+void xmpool_free(struct xmpool_t * pool, void * ptr, size_t size) {
+    assert(pool != NULL);
 
     size = XM_ALIGN(size, XM_ALIGNMENT);
+    if (ptr == NULL || size == 0 || size > XM_SMALL_MAX)
+        return;
+    *(void **)ptr = pool->free_lists[XM_SMALL_CLASS(size)];
+    pool->free_lists[XM_SMALL_CLASS(size)] = ptr;
+    pool->free_bytes += size;
+}
 
-    list_for_each(p, head) {
-        chunk = list_entry(p, struct xmpool_chunk_t, chunk_link);
-        if (XM_CHUNK_FREE_SIZE(chunk) >= size) {
-            return xmpool_chunk_do_alloc(head, chunk, size);
+void * xmpool_realloc(struct xmpool_t * pool, void * ptr,
+                      size_t old_size, size_t size) {
+    struct xmpool_chunk_t * chunk = pool->current;
+    struct xmpool_large_chunk_t ** prev, * large;
+    char * res;
+    assert(pool != NULL);
+
+    if (ptr == NULL)
+        return xmpool_alloc(pool, size);
+
+    old_size = XM_ALIGN(old_size, XM_ALIGNMENT);
+    size = XM_ALIGN(size, XM_ALIGNMENT);
+
+    /* the last allocation of the current chunk, not cut by a release */
+    if ((char *)ptr + old_size == chunk->first &&
+        (chunk != pool->floor_chunk || (char *)ptr >= pool->floor) &&
+        ((size_t)(chunk->smem + chunk->size - (char *)ptr) >= size ||
+         (chunk == pool->arena &&
+          xmpool_arena_commit(pool, size - old_size) == 0))) {
+        chunk->first = (char *)ptr + size;
+        return ptr;
+    }
+    if (size <= old_size)
+        return ptr;
+
+    /* xmpool_free() does not take large blocks back, resize them */
+    if (old_size > pool->chunk_size) {
+        for (prev = &pool->large; *prev != pool->floor_large;
+             prev = &(*prev)->next) {
+            large = *prev;
+            if (large->data != ptr)
+                continue;
+            large = XM_REALLOC(pool->allocator, large,
+                               XM_LARGE_HEADER_SIZE + size);
+            if (large == NULL)
+                return NULL;
+            pool->bytes -= XM_LARGE_HEADER_SIZE + large->size;
+            XM_ACCOUNT(pool, XM_LARGE_HEADER_SIZE + size);
+            large->data = (char *)large + XM_LARGE_HEADER_SIZE;
+            large->size = size;
+            *prev = large;
+            return large->data;
         }
     }
 
-    return xmpool_chunklist_grow_alloc(pool, size);
+    if ((res = xmpool_alloc(pool, size)) == NULL)
+        return NULL;
+    memcpy(res, ptr, old_size);
+    xmpool_free(pool, ptr, old_size);
+
+    return res;
 }
 
-void xmpool_destroy(struct xmpool_t * pool) {
+struct xmpool_mark_t xmpool_mark(struct xmpool_t * pool) {
+    struct xmpool_mark_t mark;
     assert(pool != NULL);
-    struct list_head * p, *q;
+
+    mark.chunk = pool->current;
+    mark.first = pool->current->first;
+    mark.chunks = pool->chunks;
+    mark.next_chunk_size = pool->next_chunk_size;
+    mark.large = pool->large;
+    mark.floor_chunk = pool->floor_chunk;
+    mark.floor = pool->floor;
+    mark.floor_large = pool->floor_large;
+    pool->floor_chunk = mark.chunk;
+    pool->floor = mark.first;
+    pool->floor_large = mark.large;
+
+    return mark;
+}
+
+void xmpool_release(struct xmpool_t * pool, struct xmpool_mark_t * mark) {
     struct xmpool_chunk_t * chunk;
-    
-    for (p = pool->chunk_list.next; p != &pool->chunk_list;p = q) {
+    struct xmpool_large_chunk_t * large, * next;
+    assert(pool != NULL);
+    assert(mark != NULL);
+
+    /* chunks newer than the mark sit before it in the chunk list */
+    while ((chunk = pool->current) != mark->chunk) {
+        assert(!list_empty(&pool->chunk_list));
+        list_del(&chunk->chunk_link);
+        chunk->first = chunk->smem;
+        list_add(&chunk->chunk_link, &pool->spare_list);
+        pool->current = list_first_entry(&pool->chunk_list,
+                                         struct xmpool_chunk_t, chunk_link);
+    }
+    chunk->first = mark->first;
+    pool->chunks = mark->chunks;
+    /* the free lists may hold blocks allocated after the mark */
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    pool->free_bytes = 0;
+    pool->next_chunk_size = mark->next_chunk_size;
+
+    for (large = pool->large; large != mark->large; large = next) {
+        assert(large != NULL);
+        next = large->next;
+        pool->bytes -= XM_LARGE_HEADER_SIZE + large->size;
+        XM_FREE(pool->allocator, large);
+    }
+    pool->large = mark->large;
+    pool->floor_chunk = mark->floor_chunk;
+    pool->floor = mark->floor;
+    pool->floor_large = mark->floor_large;
+}
+
+void xmpool_usage(struct xmpool_t * pool, struct xmpool_usage_t * usage) {
+    struct xmpool_chunk_t * chunk;
+    struct xmpool_large_chunk_t * large;
+    struct list_head * p;
+    assert(pool != NULL);
+    assert(usage != NULL);
+
+    memset(usage, 0, sizeof(*usage));
+    usage->bytes = pool->bytes;
+    usage->peak_bytes = pool->peak_bytes;
+    usage->free_listed = pool->free_bytes;
+    list_for_each(p, &pool->chunk_list) {
+        chunk = XM_CHUNK_OF(p);
+        usage->chunk_used += chunk->first - chunk->smem;
+        if (chunk == pool->current)
+            usage->chunk_free += XM_CHUNK_FREE_SIZE(chunk);
+        else
+            usage->chunk_wasted += XM_CHUNK_FREE_SIZE(chunk);
+    }
+    list_for_each(p, &pool->spare_list) {
+        usage->chunk_spare += XM_CHUNK_OF(p)->size;
+    }
+    for (large = pool->large; large; large = large->next)
+        usage->large_used += large->size;
+}
+
+static void xmpool_chunklist_free(struct xmpool_t * pool, struct list_head * head) {
+    struct list_head * p, *q;
+
+    for (p = head->next; p != head; p = q) {
         q = p->next;
-        chunk = list_entry(p, struct xmpool_chunk_t, chunk_link);
-        free(chunk->smem);
-        free(chunk);
+        if (XM_CHUNK_OF(p) == pool->arena)
+            continue;
+        if (XM_RECYCLES(pool) && xmpool_recycler_put(XM_CHUNK_OF(p)))
+            continue;
+        XM_FREE(pool->allocator, XM_CHUNK_OF(p));
+    }
+    INIT_LIST_HEAD(head);
+}
+
+void xmpool_destroy(struct xmpool_t * pool) {
+    assert(pool != NULL);
+    struct xmpool_large_chunk_t * large, * next;
+    
+    xmpool_chunklist_free(pool, &pool->chunk_list);
+    xmpool_chunklist_free(pool, &pool->spare_list);
+    for (large = pool->large; large; large = next) {
+        next = large->next;
+        XM_FREE(pool->allocator, large);
     }
+    if (pool->arena) {
+        munmap(pool->arena, pool->arena_reserved);
+        pool->arena = NULL;
+    }
+    pool->large = NULL;
+    pool->floor_chunk = NULL;
+    pool->floor = NULL;
+    pool->floor_large = NULL;
+    pool->current = NULL;
     pool->chunks = 0;
-}
\ No newline at end of file
+    pool->bytes = 0;
+    memset(pool->free_lists, 0, sizeof(pool->free_lists));
+    pool->free_bytes = 0;
+}
@@ -60,11 +60,12 @@ typedef enum xson_ele_type {
     ELE_TYPE_STRING,
     ELE_TYPE_NUMBER,
     ELE_TYPE_BOOL,
-    ELE_TYPE_PAIR,
+    ELE_TYPE_PAIR,      /* no node has it, objects store their members */
     ELE_TYPE_NULL
 }xson_ele_type;
 
 struct xson_element;
+struct xson_object;
 
 typedef struct xson_lex_element {
     xson_lex_state state;
@@ -72,7 +73,19 @@ typedef struct xson_lex_element {
     * @start, @end: pinpoint(inclusive) the contents of this element inside the json string.
     */
     char *start, *end;
+    /* the element parsed, NULL for the ',' and ':' separators. */
     struct xson_element * element;
+    /* cached hash of a key string, 0 if not computed yet. */
+    unsigned hash;
+    /*
+    * The projection node of a key, or for an object or array the node
+    * of the enclosing element, see xson_parse_projected().
+    */
+    int proj;
+    /* for an object, the shape of the enclosing object, see xson_context. */
+    struct xson_object * shape;
+    /* the enclosing element, restored when an object or array is closed. */
+    struct xson_element * parent;
 }xson_lex_element;
 
 
@@ -82,16 +95,25 @@ typedef struct xson_lex_element {
 * *@buffer holds the new buffer address,
 * *@old_len holds the new buffer size.
 * Return value: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if failed to reallocate memory for the buffer.
+* @allocator: the allocator the buffer is allocated with.
 * @buffer: the buffer address to expand and holds the result buffer address.
 * @old_len: the size of the old buffer and holds the new buffer size.
 * @len: the expected number of elements in the buffer.
 * @ele_size: the size of each element in the buffer.
 */
-int xson_buffer_grow(void ** buffer, int *old_len, int len, int ele_size);
+int xson_buffer_grow(const struct xmpool_allocator_t * allocator,
+                     void ** buffer, int *old_len, int len, int ele_size);
+
+/*
+* Same as xson_buffer_grow() but for a buffer allocated from @pool.
+* Return value: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if failed to allocate memory for the buffer.
+* @pool: the memory pool from which the buffer is allocated.
+*/
+int xson_pool_buffer_grow(struct xmpool_t * pool, void ** buffer,
+                          int *old_len, int len, int ele_size);
 
 /*
 * Allocate @size memory from the memory pool.
-* @size must be less or equal to @pool->chunk_size which is set during initalization of the memory pool;
 * Return: the memory address newly allocated, NULL if out of memory.
 * @pool: the memory pool from which the memory is allocated.
 * @size: the desired size.
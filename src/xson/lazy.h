@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2014 Xinjing Cho
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+* 3. The name of the author may not be used to endorse or promote products
+*    derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERR
+*/
+#ifndef XSON_LAZY_H_
+#define XSON_LAZY_H_
+
+#include "types.h"
+#include "parser.h"
+#include "path.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* An object or array of the raw text, the nodes of the structural index
+* are in the order of their opening brackets, the outermost one first.
+* The offsets are from the beginning of the string of the context.
+*/
+typedef struct xson_lazy_node {
+    /* the opening bracket */
+    int start;
+    /* the closing bracket */
+    int end;
+    /* the first node after this one and its descendants */
+    int next;
+}xson_lazy_node;
+
+/*
+* Validate the string of the context and index where its objects and
+* arrays start and end, instead of building the tree with xson_parse().
+* The strings and the numbers are checked like xson_parse() does, but
+* no element is created: the fields are read by xson_lazy_get().
+* Return: XSON_RESULT_SUCCESS on success,
+*         XSON_RESULT_INVALID_JSON if the string is not a valid document,
+*         XSON_RESULT_OOM if out of memory.
+* @ctx: the context, initialized and not parsed.
+*/
+int xson_parse_lazy(struct xson_context * ctx);
+
+/*
+* Resolve an expression of xson_path_compile() against the raw text of
+* a context parsed by xson_parse_lazy(). Only the objects and arrays on
+* the way are scanned, the values before the ones looked up are skipped,
+* a whole object or array at once thanks to the structural index.
+* The element found is materialized in the pool of the context: a scalar
+* on its own, an object or array with everything under it.
+* The element lives until the context is destroyed, every call
+* materializes a new one.
+* Return: the element, or the XSON_EXPR_* error of xson_path_eval(),
+*         XSON_EXPR_INVALID_EXPR if @expr is invalid,
+*         XSON_EXPR_NULL if @ctx was not parsed by xson_parse_lazy(),
+*         XSON_EXPR_OP_NOTSUPPORTED if the object or array found holds
+*         something xson_parse() does not build (booleans or nulls in
+*         an array), XSON_EXPR_OOM if out of memory.
+* @ctx: the context.
+* @expr: the expression.
+*/
+struct xson_element * xson_lazy_get(struct xson_context * ctx,
+                                    const char * expr);
+
+/*
+* Same as xson_lazy_get() with a compiled path.
+*/
+struct xson_element * xson_lazy_eval(struct xson_context * ctx,
+                                     const struct xson_path * path);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
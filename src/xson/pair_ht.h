@@ -22,6 +22,7 @@
 */
 #ifndef XSON_PAIR_HT_H_
 #define XSON_PAIR_HT_H_
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,80 +30,209 @@ extern "C" {
 /* The load factor we apply to the hash table */
 #define LOAD_FACTOR 0.7
 
-struct list_head;
-struct xson_pair;
+/* Frozen tables with no more entries than this are kept sorted by hash */
+#define XSON_PAIR_HT_SORTED_MAX 8
+/* Number of buckets moved to the new table on every insertion while resizing */
+#define XSON_PAIR_HT_REHASH_STEP 4
+/* Average number of keys per bucket of the perfect hash */
+#define XSON_PAIR_HT_MPH_LAMBDA 4
+/*
+* One spare slot of the perfect hash per this many keys, so that the
+* last buckets placed still find free slots for some seed.
+*/
+#define XSON_PAIR_HT_MPH_HEADROOM 4
+/* Number of chain links allocated on the first insertion */
+#define XSON_PAIR_HT_INIT_LINKS 8
+/* Bits of a key Bloom filter per key expected, each key sets 2 of them */
+#define XSON_KEY_BLOOM_BITS_PER_KEY 8
+
+struct xson_key_span;
+struct xmpool_t;
+
+/* chain links of the members which are not in the table */
+#define XSON_PAIR_HT_END        (-1)    /* last member of a chain */
+#define XSON_PAIR_HT_SHADOWED   (-2)    /* a former member has the same key */
+
+/*
+* A Bloom filter of key hashes: a key whose bits are not all set is in
+* none of the tables the filter stands for. Keys are never removed.
+*/
+typedef struct xson_key_bloom {
+    unsigned * bits;
+    /* the number of bits minus one, which is a power of 2 */
+    unsigned mask;
+}xson_key_bloom;
+
+typedef struct xson_pair_ht_slot {
+    unsigned hash;
+    /* index of the member in the object */
+    int idx;
+}xson_pair_ht_slot;
+
+/*
+* The hash table indexes the members of an object by their position in
+* the key array of the object, see struct xson_object. It does not own
+* the keys, every function is handed the key array it indexes.
+* Only the first member of a given key is in the table, later members
+* with the same key are shadowed until the first one is deleted.
+*/
 typedef struct xson_pair_ht {
-    struct list_head * table;
+    /* the heads of the chains, member indexes or XSON_PAIR_HT_END */
+    int * table;
     /* The index of xson_pair_ht_primes we are using as the size of the hash table */
     int p_index;
     /* the number of entries this hash table has */
     int n_entries;
     /* The number of slots this hash table has */
     int len;
+    /*
+    * The chain link of every member, by member index, shared by @table
+    * and @old_table. @next_len is the number of links allocated.
+    */
+    int * next;
+    int next_len;
+    /*
+    * Incremental resizing: while @old_table is not NULL, the entries are
+    * moved bucket by bucket from @old_table of @old_len slots to @table,
+    * buckets below @rehash_idx have been moved already.
+    */
+    int * old_table;
+    int old_len;
+    int rehash_idx;
+    /*
+    * Set up by xson_pair_ht_freeze(), which replaces the chained @table
+    * by an immutable flat index of @n_slots slots.
+    * The slots are placed by a perfect hash of @len buckets displaced
+    * by @seeds, the free ones have an index of -1, or the first
+    * @n_entries slots are sorted by hash if @seeds is NULL.
+    */
+    struct xson_pair_ht_slot * slots;
+    int n_slots;
+    unsigned short * seeds;
+    /*
+    * The filter every key inserted is added to, checked before every
+    * lookup, NULL if none. It may be shared with other tables.
+    */
+    struct xson_key_bloom * bloom;
+    /* the memory pool the slots are allocated from */
+    struct xmpool_t * pool;
 }xson_pair_ht;
 
 /*
 * BKDR Hash Function.
-* @p: the pair to be hashed.
+* @key: the bytes to be hashed.
+* @len: the number of bytes.
 */
-inline unsigned xson_pair_ht_hash_by_pair(struct xson_pair * p);
+inline unsigned xson_pair_ht_hash(const char * key, size_t len);
 
 inline unsigned xson_pair_ht_hash_by_key(const char * key);
 
 /*
 * Initialize the xson_pair hash table.
+* The slots are allocated on the first insertion.
 * @ht: &struct xson_pair_ht to be initialized.
+* @pool: the memory pool from which the slots are allocated,
+*        they are freed along with the pool.
 */
-inline int xson_pair_ht_init(struct xson_pair_ht * ht);
+inline int xson_pair_ht_init(struct xson_pair_ht * ht, struct xmpool_t * pool);
 
 /*
-* Insert a xson_pair into the hash table.
-* Do nothing if the xson_pair is already in the table,
-* @ht: &struct xson_pair_ht into which the xson_pair to be inserted
-* @xson_pair: &struct xson_pair entry to be inserted
-* @key: hash key
+* Size the hash table for @size entries up front,
+* so that it does not need to be resized until then.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_OP_NOTSUPPORTED if the table is frozen.
+* @ht: the hash table.
+* @keys: the keys of the members.
+* @size: the expected number of entries.
 */
-inline int xson_pair_ht_insert(struct xson_pair_ht * ht, struct xson_pair * new_entry);
+int xson_pair_ht_reserve(struct xson_pair_ht * ht,
+                         struct xson_key_span * keys, int size);
 
 /*
-* Insert a xson_pair into the hash table. 
-* Replace old xson_pair by new one if the old xson_pair is already in the table.
-* @ht: &struct xson_pair_ht into which the xson_pair to be inserted
-* @xson_pair: &struct xson_pair entry to be inserted
-* @key: hash key
+* Index the member @idx, the key hash is computed if it is 0.
+* The member is shadowed if a member with the same key is in the table.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_OP_NOTSUPPORTED if the table is frozen.
+* @ht: the hash table.
+* @keys: the keys of the members.
+* @idx: the index of the member to be inserted, members are inserted
+*       in the order of their indexes.
 */
-inline int xson_pair_ht_insert_replace(struct xson_pair_ht * ht, struct xson_pair * new_entry);
+int xson_pair_ht_insert(struct xson_pair_ht * ht,
+                        struct xson_key_span * keys, int idx);
 
 /*
-* Delete the xson_pair with the key from the hash table.
-* Do nothing if there is no matching key.
-* @ht: &struct xson_pair_ht from which the xson_pair will be deleted
-* @key: hash key
+* Forget the member @idx before it is removed from the object,
+* the members after it are renumbered one place forward.
+* If the member was in the table, the next member with the same key
+* takes its place.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_OP_NOTSUPPORTED if the table is frozen.
+* @ht: the hash table.
+* @keys: the keys of the members, still including the member @idx.
+* @n: the number of members, still including the member @idx.
+* @idx: the index of the member to be deleted.
 */
-inline void xson_pair_ht_delete_by_key(struct xson_pair_ht * ht, const char * key);
+int xson_pair_ht_delete(struct xson_pair_ht * ht,
+                        struct xson_key_span * keys, int n, int idx);
 
 /*
-* Delete the xson_pair with the key from the hash table.
-* Do nothing if there is no matching key.
-* @ht: &struct xson_pair_ht from which the xson_pair will be deleted
-* @key: hash key
+* Retrieve the first member with the given key.
+* Return: the index of the member, -1 if there is no matching key.
+* @ht: the hash table.
+* @keys: the keys of the members.
+* @key: the key looked up, not necessarily null-terminated.
+* @len: the length of @key.
+* @hash: xson_pair_ht_hash() of @key.
 */
-inline int xson_pair_ht_delete(struct xson_pair_ht * ht, struct xson_pair * pair);
+inline int xson_pair_ht_retrieve(struct xson_pair_ht * ht,
+                                 struct xson_key_span * keys,
+                                 const char * key, size_t len, unsigned hash);
 
+/*
+* Allocate a key Bloom filter of at least @n_bits bits, all cleared.
+* Return: the filter, NULL if out of memory.
+* @pool: the memory pool the filter is allocated from.
+* @n_bits: the number of bits, rounded up to a power of 2.
+*/
+struct xson_key_bloom * xson_key_bloom_new(struct xmpool_t * pool,
+                                           size_t n_bits);
+
+/*
+* Return: the bytes taken by the filter in the pool.
+*/
+size_t xson_key_bloom_memory(const struct xson_key_bloom * bloom);
+
+/*
+* Give the table a filter of its own holding the keys of its @n members,
+* sized for them, instead of the filter it had.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory.
+* @ht: the hash table.
+* @keys: the keys of the members, hashed already.
+* @n: the number of members.
+*/
+int xson_pair_ht_own_bloom(struct xson_pair_ht * ht,
+                           struct xson_key_span * keys, int n);
 
 /*
-* Retrieve the coressponding xson_pair from the hash table.
-* Return null if there is no matching key.
-* @ht: &struct xson_pair_ht from which the xson_pair will be retrieved
-* @key: hash key
+* Rebuild the hash table as an immutable flat index: a perfect hash with
+* a spare slot per XSON_PAIR_HT_MPH_HEADROOM entries for large tables,
+* an array sorted by hash for small ones.
+* Lookups on a frozen table never collide, insertions and deletions
+* are no longer supported.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         in which case the table is left unfrozen.
+* @ht: the hash table to freeze.
+* @keys: the keys of the members.
 */
-inline struct xson_pair * xson_pair_ht_retrieve(struct xson_pair_ht * ht, const char * key);
+int xson_pair_ht_freeze(struct xson_pair_ht * ht, struct xson_key_span * keys);
 
 /*
-* Free up the hash table.
-* @ht: the hash table
+* Return: the bytes of pool memory the hash table is made of,
+*         the keys themselves not included.
+* @ht: the hash table.
 */
-inline void xson_pair_ht_free(struct xson_pair_ht * ht);
+size_t xson_pair_ht_memory(struct xson_pair_ht * ht);
 
 #ifdef __cplusplus
 }
@@ -31,6 +31,36 @@ extern "C" {
 #endif
 
 #define XSON_CTX_INIT_STK_LEN 32
+/*
+* Documents of at least this many bytes parsed with the default allocator
+* get an mmap()ed arena reserving XSON_CTX_ARENA_RATIO times their size.
+*/
+#define XSON_CTX_ARENA_MIN_LEN (1 << 20)
+#define XSON_CTX_ARENA_RATIO 16
+
+/*
+* Bytes of json string expected per key, the document Bloom filter of
+* xson_enable_bloom_filters() is sized on it.
+*/
+#define XSON_CTX_BLOOM_BYTES_PER_KEY 16
+
+/* Longest expression a lookup cache entry holds, longer ones are not cached */
+#define XSON_LOOKUP_CACHE_EXPR_MAX 48
+
+struct xson_lazy_node;
+struct xson_projection;
+struct xson_key_bloom;
+
+/* an expression resolved by xson_get_by_expr() from the element @from */
+typedef struct xson_lookup_entry {
+    struct xson_element * from;
+    struct xson_element * result;
+    /* the generation of the document when the entry was filled */
+    unsigned long generation;
+    unsigned hash;
+    unsigned len;
+    char expr[XSON_LOOKUP_CACHE_EXPR_MAX];
+}xson_lookup_entry;
 
 typedef struct xson_context {
     char * str_buf;
@@ -43,8 +73,91 @@ typedef struct xson_context {
     /* root of the json elements. */
     struct xson_element * root;
     struct xmpool_t pool;
+    /* set by xson_freeze() */
+    int frozen;
+
+    /* bumped by every modification of the document */
+    unsigned long generation;
+    /*
+    * The lookup cache of xson_get_by_expr(), direct mapped on the hash
+    * of the expression, NULL unless enabled by xson_enable_lookup_cache().
+    */
+    struct xson_lookup_entry * cache;
+    unsigned cache_len;
+
+    /* the structural index built by xson_parse_lazy(), see xson/lazy.h */
+    struct xson_lazy_node * lazy;
+    int lazy_len;
+
+    /*
+    * The projection of xson_parse_projected() and the node of the element
+    * being parsed, -1 if everything under it is kept.
+    */
+    const struct xson_projection * projection;
+    int proj_node;
+
+    /*
+    * Parse-time only: the previous sibling in the enclosing array of the
+    * object being parsed, whose key order is used to predict its keys,
+    * NULL if there is none or a prediction has failed. Saved in the lex
+    * element of a nested object and restored when it is closed.
+    */
+    struct xson_object * shape;
+
+    /*
+    * The Bloom filter of the keys of the document, NULL unless enabled by
+    * xson_enable_bloom_filters(), and the number of members from which
+    * an object gets a filter of its own, 0 if none does.
+    */
+    struct xson_key_bloom * bloom;
+    int bloom_min;
 }xson_context;
 
+/*
+* Bytes of memory used by a context, see xson_memory_stats().
+* Every byte counted below comes from the pool of the context.
+*/
+typedef struct xson_mem_stats {
+    /* memory obtained by the pool, chunk headers included, now and at most */
+    size_t pool_bytes;
+    size_t pool_peak_bytes;
+    /* bytes handed out from the pool chunks and allocated on their own */
+    size_t chunk_used;
+    size_t large_used;
+    /* bytes left unused at the end of the chunks filled up already */
+    size_t chunk_wasted;
+    /* bytes still free in the current chunk or in spare chunks */
+    size_t chunk_free;
+    /*
+    * Number of elements and their bytes, internal structs included, by type.
+    * The members of the objects are counted as pairs, they take no bytes
+    * but their share of the children vectors.
+    */
+    size_t elements[ELE_TYPE_NULL + 1];
+    size_t element_bytes[ELE_TYPE_NULL + 1];
+    /* the hash tables of the objects */
+    size_t hash_table_bytes;
+    /* the key Bloom filters, see xson_enable_bloom_filters() */
+    size_t bloom_bytes;
+    /*
+    * The children vectors of the objects, keys and values, and of the
+    * arrays, and their unused part.
+    */
+    size_t child_vector_bytes;
+    size_t child_vector_unused;
+    /* the copy of the json string */
+    size_t string_bytes;
+    /* the lex stack, which never shrinks so this is also its peak */
+    size_t lex_stack_bytes;
+    /* bytes given back to the pool, waiting to be reused */
+    size_t free_listed_bytes;
+    /*
+    * The rest of the used bytes: mostly the old copies of the vectors,
+    * hash tables and lex stack left behind as they grew.
+    */
+    size_t unreferenced_bytes;
+}xson_mem_stats;
+
 /*
 * Initialize a context for parsing.
 * Return: 0 on success, -1 on failure(out of memory).
@@ -53,6 +166,16 @@ typedef struct xson_context {
 */
 int xson_init(struct xson_context * ctx, const char * str);
 
+/*
+* Same as xson_init() but every allocation made for the context, the pool
+* chunks, the string copy, the lex stack and the scratch buffers of the
+* lookups, goes through @allocator.
+* Return: 0 on success, -1 on failure(out of memory).
+* @allocator: the allocator, which must outlive the context.
+*/
+int xson_init_with_allocator(struct xson_context * ctx, const char * str,
+                             const struct xmpool_allocator_t * allocator);
+
 /*
 * Do the real parsing for the ctx.
 * Return: 0 on success, -1 on failure.
@@ -61,6 +184,83 @@ int xson_init(struct xson_context * ctx, const char * str);
 */
 int xson_parse(struct xson_context * ctx, struct xson_element ** out);
 
+/*
+* Same as xson_parse() but only the values on @proj end up in the document.
+* The members of the objects that are not on it are skipped as a whole:
+* brackets are counted and strings skipped but nothing else is checked,
+* and no element is created for them. An object keeps its members on the
+* projection, an array all its elements, each one projected alike.
+* Return: 0 on success, -1 on failure.
+* @ctx: the context being parsed.
+* @proj: the projection, see xson_projection_compile() in xson/path.h.
+* @out: holds the root element if successfully parsed
+*/
+int xson_parse_projected(struct xson_context * ctx,
+                         const struct xson_projection * proj,
+                         struct xson_element ** out);
+
+/*
+* Parse the bytes from @start up to @end of the string of the context
+* into @root, see xson/lazy.h.
+* Return: 0 on success, XSON_RESULT_INVALID_JSON, XSON_RESULT_OOM or
+*         XSON_RESULT_ERROR on failure.
+* @ctx: the context.
+* @root: an empty root element of the context.
+* @start: the first byte of a single object or array.
+* @end: the byte after it.
+*/
+int xson_parse_range(struct xson_context * ctx, struct xson_element * root,
+                     char * start, char * end);
+
+/*
+* Freeze the parsed document for read-mostly use: the hash table of every
+* object is rebuilt into a compact immutable index (a perfect hash over
+* a quarter more slots than members, or a sorted array for small objects)
+* so that key lookups never collide. Nothing in the document is modified
+* afterwards and reading it allocates nothing, so it can be read by
+* several threads at a time without locking, unless its lookup cache is
+* enabled, see xson_enable_lookup_cache().
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory.
+* @ctx: the context holding a successfully parsed document.
+*/
+int xson_freeze(struct xson_context * ctx);
+
+/*
+* Enable the lookup cache of the context: xson_get_by_expr() and the
+* getters built on it remember the elements the last expressions led to,
+* until the document is modified through the API. A repeated lookup then
+* takes a single probe. The cache is filled by the lookups, so a context
+* with the cache enabled must not be read by several threads at a time,
+* use compiled paths for that, see xson/path.h.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory.
+* @ctx: the context.
+* @size: the number of entries, rounded up to a power of 2,
+*        0 to disable the cache.
+*/
+int xson_enable_lookup_cache(struct xson_context * ctx, int size);
+
+/*
+* Have the key lookups of the document go through Bloom filters of the
+* keys built while parsing, so that a missing key is mostly rejected by
+* 2 bit tests before its hash table is probed. The objects share
+* a filter of all the keys of the document, sized on the length of the
+* string, large objects get a filter of their own once parsed.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_OP_NOTSUPPORTED if the context is parsed already.
+* @ctx: the context, initialized and not parsed.
+* @min_members: the number of members from which an object gets
+*               a filter of its own, 0 for the document filter only.
+*/
+int xson_enable_bloom_filters(struct xson_context * ctx, int min_members);
+
+/*
+* Tell how much memory the context uses and what for.
+* @ctx: the context, parsed or not.
+* @stats: holds the result.
+*/
+void xson_memory_stats(struct xson_context * ctx,
+                       struct xson_mem_stats * stats);
+
 /*
 * Clean and free up the context.
 * @ctx: the context being destroyed.
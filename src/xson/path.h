@@ -0,0 +1,250 @@
+/*
+* Copyright (c) 2014 Xinjing Cho
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+* 3. The name of the author may not be used to endorse or promote products
+*    derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERR
+*/
+#ifndef XSON_PATH_H_
+#define XSON_PATH_H_
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+* A step of a compiled path: a key looked up in an object,
+* or an index into an array if @key is NULL.
+*/
+typedef struct xson_path_step {
+    const char * key;
+    unsigned len;
+    /* xson_pair_ht_hash() of @key */
+    unsigned hash;
+    int index;
+}xson_path_step;
+
+/*
+* An expression of xson_get_by_expr() parsed once for all.
+* The steps and the key bytes live in the same block as the path.
+*/
+typedef struct xson_path {
+    int n_steps;
+    struct xson_path_step * steps;
+    const struct xmpool_allocator_t * allocator;
+}xson_path;
+
+/*
+* Compile an expression of dot-separated keys, each one followed by
+* any number of array indexes, like "key1.key2[n].key3". The first key
+* may be empty to index a top level array: "[n].key1".
+* Return: the compiled path, to be freed by xson_path_free(),
+*         NULL if @expr is invalid or out of memory.
+* @expr: the expression.
+*/
+struct xson_path * xson_path_compile(const char * expr);
+
+/*
+* Compile an expression with the memory allocated by @allocator,
+* see xson_path_compile().
+*/
+struct xson_path *
+xson_path_compile_with_allocator(const char * expr,
+                                 const struct xmpool_allocator_t * allocator);
+
+/*
+* Evaluate a compiled path. Nothing is allocated and the path is
+* not modified, a path can be evaluated by several threads at once.
+* Return: a pointer to the element the path leads to,
+*         XSON_EXPR_NULL if @elt or @path is null,
+*         XSON_EXPR_KEY_NOT_EXIST if a key is missing,
+*         XSON_EXPR_INDEX_OOR if an index is out of range,
+*         XSON_EXPR_TYPE_MISMATCH if a key is looked up in something
+*         else than an object, or an index in something else than an array.
+* @elt: the element to start with, a root element stands for its child.
+* @path: the compiled path.
+*/
+struct xson_element * xson_path_eval(struct xson_element * elt,
+                                     const struct xson_path * path);
+
+/*
+* Free a compiled path.
+*/
+void xson_path_free(struct xson_path * path);
+
+/* how the element a field leads to is converted by xson_extract() */
+typedef enum xson_field_type {
+    XSON_FIELD_ELEMENT,     /* the element itself */
+    XSON_FIELD_LLONG,       /* a number, see xson_number_to_llong() */
+    XSON_FIELD_DOUBLE,      /* a number, see xson_number_to_double() */
+    XSON_FIELD_BOOL,        /* a bool, see xson_bool_to_int() */
+    XSON_FIELD_STRING       /* a string, the span is not copied */
+}xson_field_type;
+
+/* a field to be extracted, @expr is an expression of xson_path_compile() */
+typedef struct xson_field {
+    const char * expr;
+    enum xson_field_type type;
+}xson_field;
+
+/* a field filled by xson_extract() */
+typedef struct xson_field_value {
+    /*
+    * XSON_RESULT_SUCCESS if the field is extracted, otherwise
+    * XSON_RESULT_KEY_NOT_EXIST, XSON_RESULT_OOR, XSON_RESULT_TYPE_MISMATCH
+    * or the error of the conversion.
+    */
+    int result;
+    /* the element the field leads to, NULL if there is none */
+    struct xson_element * elt;
+    union {
+        long long llong;
+        double dbl;
+        int xbool;
+        struct xson_string string;
+    }u;
+}xson_field_value;
+
+typedef struct xson_extract_field {
+    enum xson_field_type type;
+    /* the next field ending at the same node, -1 if none */
+    int next;
+}xson_extract_field;
+
+typedef struct xson_extract_node {
+    struct xson_path_step step;
+    /* the number of steps from the element walked, from 1 */
+    int depth;
+    /* the first field ending at this node, -1 if none */
+    int field;
+}xson_extract_node;
+
+/*
+* A set of fields compiled into a trie of steps, the fields sharing
+* a prefix share its nodes. The nodes are laid out depth first.
+*/
+typedef struct xson_extractor {
+    int n_nodes;
+    struct xson_extract_node * nodes;
+    int n_fields;
+    struct xson_extract_field * fields;
+    /* the number of steps of the longest field */
+    int max_depth;
+    /* the compiled fields, they hold the key bytes of the nodes */
+    struct xson_path ** paths;
+    const struct xmpool_allocator_t * allocator;
+}xson_extractor;
+
+/*
+* Compile a set of fields to be extracted at once by xson_extract().
+* Return: the extractor, to be freed by xson_extractor_free(),
+*         NULL if an expression is invalid or out of memory.
+* @fields: the fields, @fields[i] is extracted into the i-th value.
+* @n: the number of fields.
+*/
+struct xson_extractor * xson_extractor_compile(const struct xson_field * fields,
+                                               int n);
+
+/*
+* Compile a set of fields with the memory allocated by @allocator,
+* see xson_extractor_compile().
+*/
+struct xson_extractor *
+xson_extractor_compile_with_allocator(const struct xson_field * fields, int n,
+                                      const struct xmpool_allocator_t * allocator);
+
+/*
+* Extract every field of @ex in a single pass over the trie, each step
+* shared by several fields is taken once. Nothing is allocated unless a
+* field is deeper than XSON_VISIT_STACK_DEPTH, an extractor can be used
+* by several threads at once.
+* Return: the number of fields extracted,
+*         XSON_RESULT_ERROR if @elt, @ex or @values is null,
+*         XSON_RESULT_OOM if out of memory.
+* @elt: the element to start with, a root element stands for its child.
+* @ex: the extractor.
+* @values: an array of @ex->n_fields values, each one is filled.
+*/
+int xson_extract(struct xson_element * elt, const struct xson_extractor * ex,
+                 struct xson_field_value * values);
+
+/*
+* Free an extractor.
+*/
+void xson_extractor_free(struct xson_extractor * ex);
+
+/*
+* A node of a projection, the node 0 stands for the whole document
+* and the others for a key under their parent.
+*/
+typedef struct xson_projection_node {
+    const char * key;
+    unsigned len;
+    /* set if the whole value is kept, the children are not looked at */
+    int leaf;
+    /* the first child and the next child of the same parent, -1 if none */
+    int child;
+    int sibling;
+}xson_projection_node;
+
+/*
+* A set of expressions compiled into a trie of keys, the values that are
+* not on it are skipped by xson_parse_projected(), see xson/parser.h.
+*/
+typedef struct xson_projection {
+    int n_nodes;
+    struct xson_projection_node * nodes;
+    int n_paths;
+    /* the compiled expressions, they hold the key bytes of the nodes */
+    struct xson_path ** paths;
+    const struct xmpool_allocator_t * allocator;
+}xson_projection;
+
+/*
+* Compile the expressions of the values to be kept by
+* xson_parse_projected(). An expression keeps the value it leads to with
+* everything under it, the objects on the way keep only the members on
+* an expression. The indexes are not taken into account: every element
+* of an array is projected alike, "a[0].b" and "a.b" are the same.
+* Return: the projection, to be freed by xson_projection_free(),
+*         NULL if an expression is invalid or out of memory.
+* @exprs: the expressions of xson_path_compile().
+* @n: the number of expressions.
+*/
+struct xson_projection * xson_projection_compile(const char * const * exprs,
+                                                 int n);
+
+/*
+* Compile a projection with the memory allocated by @allocator,
+* see xson_projection_compile().
+*/
+struct xson_projection *
+xson_projection_compile_with_allocator(const char * const * exprs, int n,
+                                       const struct xmpool_allocator_t * allocator);
+
+/*
+* Free a projection.
+*/
+void xson_projection_free(struct xson_projection * proj);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
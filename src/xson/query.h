@@ -0,0 +1,158 @@
+/*
+* Copyright (c) 2014 Xinjing Cho
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions
+* are met:
+* 1. Redistributions of source code must retain the above copyright
+*    notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright
+*    notice, this list of conditions and the following disclaimer in the
+*    documentation and/or other materials provided with the distribution.
+* 3. The name of the author may not be used to endorse or promote products
+*    derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+* IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+* NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+* DATA, OR PROFITS; OR BUSINESS INTERR
+*/
+#ifndef XSON_QUERY_H_
+#define XSON_QUERY_H_
+
+#include "types.h"
+#include "path.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum xson_query_op_type {
+    XSON_QUERY_KEY,         /* the member of an object with a given key */
+    XSON_QUERY_INDEX,       /* an element of an array, from the end if < 0 */
+    XSON_QUERY_SLICE,       /* the elements of an array in [start:end:step] */
+    XSON_QUERY_WILDCARD,    /* every member of an object or element of an array */
+    XSON_QUERY_DESCEND,     /* the element itself and all its descendants */
+    XSON_QUERY_FILTER       /* the members or elements passing a test */
+}xson_query_op_type;
+
+typedef enum xson_query_cmp {
+    XSON_QUERY_EXISTS,      /* the tested element exists */
+    XSON_QUERY_EQ,
+    XSON_QUERY_NE,
+    XSON_QUERY_LT,
+    XSON_QUERY_LE,
+    XSON_QUERY_GT,
+    XSON_QUERY_GE
+}xson_query_cmp;
+
+/*
+* The test of a filter: the element @path leads to from the candidate
+* is compared with a literal of type @type, which is one of
+* ELE_TYPE_NUMBER, ELE_TYPE_STRING, ELE_TYPE_BOOL or ELE_TYPE_NULL.
+* An element of another type than the literal is only != to it.
+*/
+typedef struct xson_query_filter {
+    /* relative to the candidate, NULL to test the candidate itself */
+    struct xson_path * path;
+    enum xson_query_cmp cmp;
+    enum xson_ele_type type;
+    double number;
+    const char * string;
+    unsigned len;
+    int xbool;
+}xson_query_filter;
+
+typedef struct xson_query_op {
+    enum xson_query_op_type type;
+    /* XSON_QUERY_KEY */
+    const char * key;
+    unsigned len;
+    unsigned hash;
+    /* XSON_QUERY_INDEX in @start, XSON_QUERY_SLICE */
+    int start, end, step;
+    unsigned char has_start, has_end;
+    /* XSON_QUERY_FILTER */
+    struct xson_query_filter * filter;
+}xson_query_op;
+
+/*
+* A compiled query: a plan of operations, each one applied to
+* the elements selected by the previous one.
+* The operations, the filters and a copy of the expression holding
+* the keys and the string literals live in the same block.
+*/
+typedef struct xson_query {
+    int n_ops;
+    struct xson_query_op * ops;
+    const struct xmpool_allocator_t * allocator;
+}xson_query;
+
+/*
+* Called with every match of a query.
+* Return: XSON_VISIT_CONTINUE to go on, XSON_VISIT_STOP to stop.
+* @elt: the element matched.
+* @arg: the argument handed to xson_query_exec().
+*/
+typedef int (*xson_query_fn)(struct xson_element * elt, void * arg);
+
+/*
+* Compile a JSONPath expression. The supported subset is:
+*   $                   the element the query is run on, optional
+*   .key ['key']        the member of an object
+*   .* [*]              every member of an object or element of an array
+*   ..key ..* ..[n]     the same, applied to the element and all
+*                       its descendants
+*   [n]                 an element of an array, from the end if n < 0
+*   [start:end:step]    a slice of an array, each part may be omitted
+*   [?(@.a.b[n] op v)]  the members or elements for which the test holds,
+*                       op is one of == != < <= > >=, v one of a number,
+*                       a 'string' or "string", true, false or null.
+*                       [?(@.a)] tests that the member a exists,
+*                       @ alone stands for the member or element itself.
+* Escapes in quoted keys and strings, unions and script expressions
+* are not supported.
+* Return: the compiled query, to be freed by xson_query_free(),
+*         NULL if @expr is invalid or out of memory.
+* @expr: the expression.
+*/
+struct xson_query * xson_query_compile(const char * expr);
+
+/*
+* Compile a query with the memory allocated by @allocator,
+* see xson_query_compile().
+*/
+struct xson_query *
+xson_query_compile_with_allocator(const char * expr,
+                                  const struct xmpool_allocator_t * allocator);
+
+/*
+* Run a query, @fn is called with every match as soon as it is found,
+* no result set is built. The plan is executed with a stack of one frame
+* per operation in progress, which is only allocated when more than
+* XSON_VISIT_STACK_DEPTH frames are needed.
+* A query can be run by several threads at once.
+* Return: XSON_RESULT_SUCCESS if the query went through,
+*         XSON_VISIT_STOP if @fn stopped it,
+*         XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_ERROR if @elt, @query or @fn is null.
+* @elt: the element to start with, a root element stands for its child.
+* @query: the compiled query.
+* @fn: the callback.
+* @arg: passed to @fn.
+*/
+int xson_query_exec(struct xson_element * elt, const struct xson_query * query,
+                    xson_query_fn fn, void * arg);
+
+/*
+* Free a compiled query.
+*/
+void xson_query_free(struct xson_query * query);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
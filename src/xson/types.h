@@ -47,22 +47,22 @@ typedef struct xson_ele_operations {
     * Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if
     *         there is a memory shortage during the initialization.
     */
-    int (*initialize)(struct xson_element * ele, struct xson_lex_element * lex);
-    /*
-    * Free up resources held by the element recursively.
-    */ 
-    void (*destroy)(struct xson_element * ele);
+    int (*initialize)(struct xson_context * ctx, struct xson_element * ele,
+                      struct xson_lex_element * lex);
     
 
     /*
-    * Get child element by an expression(key1.key2[i].key3....).
+    * Get child element by a segment of an expression(key or key[i]),
+    * the @len bytes of @expr are not necessarily null-terminated.
+    * Nothing is modified or allocated.
     * Return: a pointer to the child element,
     *         XSON_RESULT_OP_NOTSUPPORTED if this type of element 
     *         does not support this operation(xson_string, xson_number),
     *         XSON_RESULT_INVALID_JSON if @expr is invalid for
     *         this type of element.
     */
-    struct xson_element * (*get_child)(struct xson_element * ele, const char * expr);
+    struct xson_element * (*get_child)(struct xson_element * ele,
+                                       const char * expr, size_t len);
 
     /*
     * Add a element to another element as a child.
@@ -78,39 +78,85 @@ typedef struct xson_ele_operations {
     * Print out the element contents recursively.
     */
     void (*print)(struct xson_element * ele, int level, int indent, int dont_break_on_first_line);
+    /*
+    * Rebuild the lookup structures of the element into their
+    * compact immutable form recursively.
+    * Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if
+    *         there is a memory shortage during the rebuilding.
+    */
+    int (*freeze)(struct xson_element * ele);
+    /*
+    * Give the internal structure of the element and everything
+    * under it back to the pool, see xson_element_destroy().
+    */
+    void (*destroy)(struct xson_context * ctx, struct xson_element * ele);
 }xson_ele_operations;
 
-typedef struct xson_pair {
-    struct xson_element * key;
-    struct xson_element * value;
-    struct list_head hash_link;
-}xson_pair;
-
 /*
-* Get the key of a pair.
-* Return: a pointer that key element, NULL if pair is null or
-*         there is no key cotained in the pair.
+* The operations of every element type, indexed by enum xson_ele_type.
+* Elements do not carry a pointer to their operations.
 */
-struct xson_string* xson_pair_get_key(struct xson_pair * pair);
+extern struct xson_ele_operations * const xson_ele_ops[];
+#define XSON_OPS(ele) (xson_ele_ops[(ele)->type])
 
 /*
-* Get the value of a pair.
-* Return: a pointer that value element, NULL if pair is null or
-*         there is no value element cotained in the pair.
+* The key of an object member: a span of the json string
+* and its cached hash, 0 if not computed yet.
 */
-struct xson_element* xson_pair_get_value(struct xson_pair * pair);
+typedef struct xson_key_span {
+    char * start;
+    unsigned len;
+    unsigned hash;
+}xson_key_span;
 
 typedef struct xson_object {
 #define XSON_OBJECT_INIT_PAIRS_SIZE 8
+    /* the context the object belongs to, for its memory pool */
+    struct xson_context * ctx;
+    /* indexes the members by their position in @keys */
     struct xson_pair_ht ht;
-    struct xson_element ** pairs;
+    /*
+    * The members in document order, as parallel arrays of their keys
+    * and their values. @idx members out of room for @size.
+    */
+    struct xson_key_span * keys;
+    struct xson_element ** values;
     int idx;
     int size;
 }xson_object;
 
+/*
+* Append a member to the object.
+* Return: XSON_RESULT_SUCCESS on success, XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_OP_NOTSUPPORTED if the document is frozen.
+* @obj: the object.
+* @key: the key of the member, it has to live as long as the document.
+* @len: the length of @key.
+* @hash: xson_pair_ht_hash() of @key, 0 to have it computed.
+* @value: the value of the member.
+*/
+int xson_object_add_member(struct xson_object * obj, char * key, unsigned len,
+                           unsigned hash, struct xson_element * value);
+
 /*
 * Get the pair to which @key is mapped.
-* Return: a pointer to that value element, NULL if the object
+* The object does not store pairs, @out is filled with a view of the member,
+* which stays valid as long as the member.
+* Return: XSON_RESULT_SUCCESS on success,
+*         XSON_RESULT_KEY_NOT_EXIST if the object contains no mapping for @key,
+*         XSON_RESULT_ERROR if an argument is null.
+* @obj: the object.
+* @key: the key looked up.
+* @out: the pair to fill, owned by the caller.
+*/
+int xson_object_get_pair_into(struct xson_object * obj, const char * key,
+                              struct xson_pair * out);
+
+/*
+* Same as xson_object_get_pair_into(), the view is filled in storage local
+* to the calling thread: it is not reentrant, the pair is overwritten by
+* the next call in that thread.
+* Return: a pointer to that pair, NULL if the object
 *         contains no mapping for @key.
 */
 struct xson_pair* xson_object_get_pair(struct xson_object * obj, const char * key);
@@ -122,6 +168,48 @@ struct xson_pair* xson_object_get_pair(struct xson_object * obj, const char * ke
 */
 struct xson_element* xson_object_get_pairval(struct xson_object * obj, const char * key);
 
+/*
+* Same as xson_object_get_pair() with a key of @len bytes,
+* which does not need to be null-terminated. The pair is overwritten
+* by the next call in the calling thread.
+*/
+struct xson_pair* xson_object_get_pair_n(struct xson_object * obj,
+                                         const char * key, size_t len);
+
+/*
+* A key hashed once for all by xson_key_make(), to be looked up
+* in many objects. Its bytes are not copied, they have to outlive it.
+*/
+typedef struct xson_key_span xson_key_t;
+
+/*
+* Make a key handle for xson_object_get_by_key().
+* Return: the key, its hash and length computed.
+* @key: the bytes of the key, not necessarily null-terminated.
+* @len: the length of @key.
+*/
+xson_key_t xson_key_make(const char * key, size_t len);
+
+/*
+* Same as xson_object_get_pairval() with a key made by xson_key_make(),
+* the lookup neither measures nor hashes the key.
+* Return: a pointer to that value element, NULL if the object
+*         contains no mapping for @key.
+*/
+struct xson_element* xson_object_get_by_key(struct xson_object * obj,
+                                            xson_key_t key);
+
+/*
+* Remove the pair to which @key is mapped from the object and give its
+* memory back to the pool. If the object holds several pairs with this
+* key, the first one is removed and the next one takes its place.
+* Return: XSON_RESULT_SUCCESS on success,
+*         XSON_RESULT_KEY_NOT_EXIST if there is no such pair,
+*         XSON_RESULT_OP_NOTSUPPORTED if the document is frozen,
+*         XSON_RESULT_ERROR if @obj or @key is null.
+*/
+int xson_object_remove_pair(struct xson_object * obj, const char * key);
+
 /*
 * Get the number of pairs contained in the object.
 * Return: the number of element contained in the object,
@@ -129,8 +217,35 @@ struct xson_element* xson_object_get_pairval(struct xson_object * obj, const cha
 */
 inline int xson_object_get_size(struct xson_object *obj);
 
+/*
+* A cursor over the members of an object in document order.
+* It holds no resources and needs no cleanup.
+*/
+typedef struct xson_object_iter {
+    struct xson_object * obj;
+    int idx;
+}xson_object_iter;
+
+/*
+* Point the cursor before the first member of @obj.
+*/
+void xson_object_iter_init(struct xson_object_iter * it, struct xson_object * obj);
+
+/*
+* Advance the cursor to the next member.
+* Return: 1 if there is one, 0 past the last member.
+* @it: the cursor.
+* @key: set to the key of the member, not null-terminated.
+* @keylen: set to the length of @key.
+* @val: set to the value of the member.
+*/
+int xson_object_iter_next(struct xson_object_iter * it, const char ** key,
+                          size_t * keylen, struct xson_element ** val);
+
 typedef struct xson_array {
 #define XSON_OBJECT_INIT_ARRAY_SIZE 16
+    /* the context the array belongs to, for its memory pool */
+    struct xson_context * ctx;
     struct xson_element ** array;
     int idx;
     int size;
@@ -142,13 +257,127 @@ typedef struct xson_array {
 */
 struct xson_element* xson_array_get_elt(struct xson_array * array, int idx);
 
+/*
+* Remove the @idxth element of the array and give its memory back to
+* the pool, the elements after it are moved one place forward.
+* Return: XSON_RESULT_SUCCESS on success,
+*         XSON_RESULT_OOR if @idx is out of range,
+*         XSON_RESULT_OP_NOTSUPPORTED if the document is frozen,
+*         XSON_RESULT_ERROR if @array is null.
+*/
+int xson_array_remove_elt(struct xson_array * array, int idx);
+
 /*
 * Get the number of elements in the array.
 */
 inline int xson_array_get_size(struct xson_array *array);
 
+/*
+* A cursor over the elements of an array.
+* It holds no resources and needs no cleanup.
+*/
+typedef struct xson_array_iter {
+    struct xson_array * array;
+    int idx;
+}xson_array_iter;
+
+/*
+* Point the cursor before the first element of @array.
+*/
+void xson_array_iter_init(struct xson_array_iter * it, struct xson_array * array);
+
+/*
+* Advance the cursor to the next element.
+* Return: 1 if there is one, 0 past the last element.
+* @it: the cursor.
+* @val: set to the element.
+*/
+int xson_array_iter_next(struct xson_array_iter * it, struct xson_element ** val);
+
+typedef enum xson_array_index_kind {
+    XSON_ARRAY_INDEX_HASH,      /* a hash table, O(1) lookups */
+    XSON_ARRAY_INDEX_SORTED     /* entries sorted by value, binary search */
+}xson_array_index_kind;
+
+/* the value of the field of an element, see xson_array_build_index() */
+typedef struct xson_array_index_entry {
+    /* ELE_TYPE_STRING or ELE_TYPE_NUMBER */
+    enum xson_ele_type type;
+    /* the span of a string */
+    const char * str;
+    unsigned len;
+    /* the hash of the string or the number */
+    unsigned hash;
+    long long num;
+    /* the position of the element in the array */
+    int pos;
+    /* the next entry of the same hash bucket, -1 if none */
+    int next;
+}xson_array_index_entry;
+
+/*
+* A secondary index of an array of objects by the value of a field,
+* allocated from the pool of the context in a single block.
+*/
+typedef struct xson_array_index {
+    /* the context of the array, whose pool holds the index */
+    struct xson_context * ctx;
+    enum xson_array_index_kind kind;
+    /* the entries, sorted by value for XSON_ARRAY_INDEX_SORTED */
+    int n_entries;
+    struct xson_array_index_entry * entries;
+    /* the heads of the buckets of XSON_ARRAY_INDEX_HASH, @mask + 1 of them */
+    int * buckets;
+    unsigned mask;
+    /* the generation of the document when the index was built */
+    unsigned long generation;
+    /* the size of the block */
+    size_t size;
+}xson_array_index;
+
+/*
+* Index the elements of an array by the value @expr leads to from each
+* of them, a string or an integer. The elements for which @expr leads
+* to nothing or to another type of value are left out.
+* The index is not updated when the document is modified, the lookups
+* fail until it is built again.
+* Return: the index, to be freed by xson_array_index_free(),
+*         NULL if @expr is invalid or out of memory.
+* @array: the array.
+* @expr: an expression of xson_path_compile(), like "ID" or "user.id".
+* @kind: the kind of index.
+*/
+struct xson_array_index *
+xson_array_build_index(struct xson_array * array, const char * expr,
+                       enum xson_array_index_kind kind);
+
+/*
+* Look up the first element whose field is the string of @len bytes
+* at @str, escapes are compared as they are in the json string.
+* Return: the position of the element in the array,
+*         XSON_RESULT_KEY_NOT_EXIST if there is none,
+*         XSON_RESULT_OP_NOTSUPPORTED if the document was modified
+*         since the index was built,
+*         XSON_RESULT_ERROR if @index or @str is null.
+*/
+int xson_array_index_find_string(const struct xson_array_index * index,
+                                 const char * str, size_t len);
+
+/*
+* Look up the first element whose field is the integer @num,
+* see xson_array_index_find_string().
+*/
+int xson_array_index_find_llong(const struct xson_array_index * index,
+                                long long num);
+
+/*
+* Give the memory of an index back to the pool.
+*/
+void xson_array_index_free(struct xson_array_index * index);
+
 typedef struct xson_value {
     struct xson_element * child;
+    struct xson_context * ctx;
 }xson_value;
 
 /*
@@ -172,6 +401,18 @@ typedef struct xson_bool {
 */
 int xson_is_array_expression(const char * expr);
 
+/*
+* Parse a segment of an expression in the form key[idx], the key may be
+* empty. An index which does not fit an int is reported as INT_MAX.
+* Return: 1 if @expr is in that form, 0 otherwise.
+* @expr: the segment, not necessarily null-terminated.
+* @len: the length of @expr.
+* @keylen: holds the length of the key.
+* @idx: holds the index.
+*/
+int xson_parse_array_expression(const char * expr, size_t len,
+                                size_t * keylen, int * idx);
+
 
 /*
 * Convert the number to a specific type.
@@ -201,14 +442,57 @@ typedef struct xson_string {
 */
 int xson_string_to_buf(struct xson_string * string, char * buf, size_t len);
 
+/*
+* A member of an object, see xson_object_get_pair().
+*/
+typedef struct xson_pair {
+    struct xson_string key;
+    struct xson_element * value;
+    /* cached hash of the key */
+    unsigned hash;
+}xson_pair;
+
+/*
+* Get the key of a pair.
+* Return: a pointer that key string, NULL if pair is null.
+*/
+struct xson_string* xson_pair_get_key(struct xson_pair * pair);
+
+/*
+* Get the value of a pair.
+* Return: a pointer that value element, NULL if pair is null or
+*         there is no value element cotained in the pair.
+*/
+struct xson_element* xson_pair_get_value(struct xson_pair * pair);
+
+/*
+* A node of the document: the type tag and the payload, inline for the
+* scalars and the root, a pointer to the container for the others.
+* The operations are found by type in xson_ele_ops[], the memory pool
+* through the enclosing container. Define XSON_NODE_PARENT to keep a
+* pointer to the parent in every node as well.
+*/
 typedef struct xson_element {
     enum xson_ele_type          type;
-    struct xson_context        *ctx;
-    struct xson_element        *parent;
-    void                       *internal;
-    struct xson_ele_operations *ops;   
+    union {
+        struct xson_string      string;     /* ELE_TYPE_STRING */
+        struct xson_number      number;     /* ELE_TYPE_NUMBER */
+        struct xson_bool        xbool;      /* ELE_TYPE_BOOL */
+        struct xson_value       value;      /* ELE_TYPE_ROOT */
+        struct xson_object      *object;    /* ELE_TYPE_OBJECT */
+        struct xson_array       *array;     /* ELE_TYPE_ARRAY */
+    }u;
+#ifdef XSON_NODE_PARENT
+    struct xson_element         *parent;
+#endif
 }xson_element;
 
+#ifdef XSON_NODE_PARENT
+#define XSON_SET_PARENT(ele, p) ((ele)->parent = (p))
+#else
+#define XSON_SET_PARENT(ele, p) ((void)0)
+#endif
+
 /*
 * Convert the element to a specific type.
 * Return: a pointer to that element of the specific type,
@@ -221,11 +505,76 @@ struct xson_number * xson_elt_to_number(struct xson_element * elt);
 struct xson_value  * xson_elt_to_value(struct xson_element * elt);
 struct xson_array  * xson_elt_to_array(struct xson_element * elt);
 struct xson_object * xson_elt_to_object(struct xson_element * elt);
-struct xson_pair   * xson_elt_to_pair(struct xson_element * elt);
+
+/*
+* Give the memory of an element detached from the document, and of
+* everything under it, back to the pool of its context, where it is
+* reused by later allocations of the same sizes.
+* The element must not be used anymore.
+* @ctx: the context the element belongs to.
+* @elt: the element to destroy.
+*/
+void xson_element_destroy(struct xson_context * ctx, struct xson_element * elt);
+
+/* what the callback of xson_visit() asks for */
+#define XSON_VISIT_CONTINUE 0   /* go on, into the children if any */
+#define XSON_VISIT_SKIP     1   /* go on, but not into the children */
+#define XSON_VISIT_STOP     2   /* stop the walk */
+
+/*
+* Called by xson_visit() on every element.
+* Return: XSON_VISIT_CONTINUE, XSON_VISIT_SKIP or XSON_VISIT_STOP.
+* @ele: the element visited.
+* @key: the key of @ele if it is an object member, NULL otherwise,
+*       not null-terminated.
+* @keylen: the length of @key.
+* @depth: 0 for the element the walk started from, 1 for its children...
+* @arg: the argument given to xson_visit().
+*/
+typedef int (*xson_visit_fn)(struct xson_element * ele, const char * key,
+                             size_t keylen, int depth, void * arg);
+
+/*
+* Walk the elements under @elt, @elt included, depth first in document
+* order. The walk is not recursive, it only allocates memory for
+* documents nested deeper than XSON_VISIT_STACK_DEPTH.
+* A root element is walked from its child.
+* Return: XSON_RESULT_SUCCESS if the walk went through,
+*         XSON_VISIT_STOP if @fn stopped it,
+*         XSON_RESULT_OOM if out of memory,
+*         XSON_RESULT_ERROR if @elt or @fn is null.
+* @elt: the element to start with.
+* @fn: the callback.
+* @arg: passed to @fn.
+*/
+#define XSON_VISIT_STACK_DEPTH 32
+int xson_visit(struct xson_element * elt, xson_visit_fn fn, void * arg);
 
 
+/*
+* Get the element an expression leads to.
+* Reading a document modifies nothing and allocates nothing, the
+* expression getters, the element getters and the conversions below are
+* reentrant: a document can be read by any number of threads at once
+* without locking, as long as none of them modifies it and its lookup
+* cache is not enabled, see xson_enable_lookup_cache().
+* Return: a pointer to that element,
+*         XSON_EXPR_NULL if @elt or @key is null,
+*         XSON_EXPR_KEY_NOT_EXIST, XSON_EXPR_INDEX_OOR,
+*         XSON_EXPR_INVALID_EXPR, XSON_EXPR_TYPE_MISMATCH or
+*         XSON_EXPR_OP_NOTSUPPORTED if the expression leads nowhere.
+* @elt: the root element to start with.
+* @key: the dot-separated keys(key1.key2.key3[n].key4 etc...),
+*        empty keys are skipped.
+*/
 struct xson_element * xson_get_by_expr(struct xson_element * elt, const char * key);
 
+/*
+* Return: the XSON_RESULT_* code of an element returned by
+*         xson_get_by_expr(), XSON_RESULT_SUCCESS for a good element.
+*/
+int xson_convert_expr_res_to_res(struct xson_element * elt);
+
 /*
 * Accessing a field of number type by expression.
 * Return: XSON_RESULT_SUCCESS if the conversion is successful,
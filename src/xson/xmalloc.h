@@ -37,7 +37,26 @@ extern "C" {
 #define XM_ALIGNMENT 8
 #define XM_ALIGN(a, b) (((a) + (b - 1)) & ~(b - 1))
 #define XM_NR_OF_LIST 16
+/* blocks freed by xmpool_free() up to this size are recycled, by size class */
+#define XM_SMALL_MAX (XM_NR_OF_LIST * XM_ALIGNMENT)
+#define XM_SMALL_CLASS(size) ((size) / XM_ALIGNMENT - 1)
 #define XM_CHUNK_SIZE 4096
+/* chunks double in size from the initial chunk size up to this */
+#define XM_MAX_CHUNK_SIZE (1 << 20)
+
+/* detected by configure and passed by the Makefile */
+#ifndef XSON_PAGE_SIZE
+#define XSON_PAGE_SIZE 4096
+#endif
+
+/*
+* An arena commits at least this much at a time: whole pages, and
+* a multiple of the 2MB huge pages with the usual 4KB pages.
+*/
+#define XM_ARENA_COMMIT_MIN (512 * XSON_PAGE_SIZE)
+/* flags of xmpool_init_arena() */
+#define XM_ARENA_HUGEPAGE 0x1   /* ask for transparent huge pages */
+#define XM_ARENA_HUGETLB  0x2   /* map explicit huge pages if the system has some */
 
 typedef struct xmpool_chunk_t {
     struct list_head chunk_link;
@@ -49,19 +68,102 @@ typedef struct xmpool_chunk_t {
     char * first;
 }xmpool_chunk_t;
 
+/* allocations larger than the chunk size, each on its own */
 typedef struct xmpool_large_chunk_t {
     void                        *data;
+    size_t                      size;
     struct xmpool_large_chunk_t *next;
 }xmpool_large_chunk_t;
 
-#define XM_INIT_CHUNKS 4
-
 typedef struct xmpool_t {
     struct list_head chunk_list;
+    /* the chunk allocations are bumped from, the head of @chunk_list */
+    struct xmpool_chunk_t * current;
     size_t chunks;
+    /* largest size served from the chunks, also the initial chunk size */
     size_t chunk_size;
+    /* size of the next chunk to allocate */
+    size_t next_chunk_size;
+    struct xmpool_large_chunk_t * large;
+    /* chunks given back by xmpool_release(), reused before allocating new ones */
+    struct list_head spare_list;
+    /* where the chunks come from */
+    const struct xmpool_allocator_t * allocator;
+    /* the mmap()ed chunk of an arena pool, see xmpool_init_arena() */
+    struct xmpool_chunk_t * arena;
+    /* bytes of address space reserved for @arena */
+    size_t arena_reserved;
+    /* bytes obtained for the chunks and large allocations, now and at most */
+    size_t bytes;
+    size_t peak_bytes;
+    /*
+    * Blocks given back by xmpool_free(), one list per size class
+    * of XM_ALIGNMENT bytes, linked through their first word.
+    */
+    void * free_lists[XM_NR_OF_LIST];
+    /* bytes on @free_lists */
+    size_t free_bytes;
+    /*
+    * Where the last checkpoint taken by xmpool_mark() is, NULL if none:
+    * the blocks below it in its chunk are not resized in place,
+    * xmpool_release() would cut them, and neither are the large blocks
+    * from @floor_large on, the checkpoints point to them.
+    */
+    struct xmpool_chunk_t * floor_chunk;
+    char * floor;
+    struct xmpool_large_chunk_t * floor_large;
 }xmpool_t;
 
+/* what the memory of a pool is used for, see xmpool_usage() */
+typedef struct xmpool_usage_t {
+    /* bytes obtained by the pool, headers included, now and at most */
+    size_t bytes;
+    size_t peak_bytes;
+    /* bytes handed out from the chunks */
+    size_t chunk_used;
+    /* bytes left unused at the end of the chunks filled up already */
+    size_t chunk_wasted;
+    /* bytes still free in the current chunk */
+    size_t chunk_free;
+    /* bytes of the chunks kept aside by xmpool_release() */
+    size_t chunk_spare;
+    /* bytes of the allocations larger than the chunk size */
+    size_t large_used;
+    /* bytes of the blocks waiting on the free lists, part of @chunk_used */
+    size_t free_listed;
+}xmpool_usage_t;
+
+/*
+* The functions every memory allocation is made with,
+* along with the @user pointer passed to them.
+*/
+typedef struct xmpool_allocator_t {
+    void * (*alloc)(void * user, size_t size);
+    void * (*realloc)(void * user, void * ptr, size_t size);
+    void   (*free)(void * user, void * ptr);
+    void * user;
+}xmpool_allocator_t;
+
+#define XM_ALLOC(a, size)        ((a)->alloc((a)->user, (size)))
+#define XM_REALLOC(a, ptr, size) ((a)->realloc((a)->user, (ptr), (size)))
+#define XM_FREE(a, ptr)          ((a)->free((a)->user, (ptr)))
+
+/* the allocator built on malloc(), realloc() and free() */
+extern const struct xmpool_allocator_t xmpool_default_allocator;
+
+/* a checkpoint of the pool, see xmpool_mark() */
+typedef struct xmpool_mark_t {
+    struct xmpool_chunk_t       *chunk;
+    char                        *first;
+    size_t                      chunks;
+    size_t                      next_chunk_size;
+    struct xmpool_large_chunk_t *large;
+    /* the checkpoint before this one, restored by xmpool_release() */
+    struct xmpool_chunk_t       *floor_chunk;
+    char                        *floor;
+    struct xmpool_large_chunk_t *floor_large;
+}xmpool_mark_t;
+
 /*
 * Intitalize a memory pool.
 * Return: 0 on success, -1 on failure.
@@ -69,9 +171,34 @@ typedef struct xmpool_t {
 */
 int xmpool_init(struct xmpool_t * pool, size_t chunk_size);
 
+/*
+* Same as xmpool_init() but the chunks are allocated with @allocator.
+* @allocator: the allocator, which must outlive the pool.
+*/
+int xmpool_init_with_allocator(struct xmpool_t * pool, size_t chunk_size,
+                               const struct xmpool_allocator_t * allocator);
+
+/*
+* Intitalize a memory pool whose memory comes from a single mmap()ed range
+* of @reserve bytes of address space. Only the part in use is committed,
+* the range grows by committing more of it, so a large document ends up
+* in one contiguous mapping, which can be backed by huge pages, instead
+* of a great many chunks. Allocations of any size are served from it.
+* Should the range fill up, the pool goes on with malloc()ed chunks.
+* Return: 0 on success, -1 on failure.
+* @pool: the memory pool being initialized
+* @reserve: the size of the range, rounded up to XM_ARENA_COMMIT_MIN.
+* @flags: XM_ARENA_HUGEPAGE and/or XM_ARENA_HUGETLB, 0 for none.
+*/
+int xmpool_init_arena(struct xmpool_t * pool, size_t reserve, int flags);
+
 /*
 * Allocates @size bytes from the pool.
 * The @size will be rounded up to the nearest multiple of 8.
+* Small allocations reuse a block of their size class given back by
+* xmpool_free() if there is one.
+* Allocations up to @pool->chunk_size are bumped from the current chunk,
+* larger ones get a memory block of their own.
 * Return: memory address on success, NULL on failure.
 * @pool: the memory pool from which the memory is allocated.
 * @size: the requested size of memory.
@@ -79,11 +206,83 @@ int xmpool_init(struct xmpool_t * pool, size_t chunk_size);
 void * xmpool_alloc(struct xmpool_t * pool, size_t size);
 
 
+/*
+* Give a block of @size bytes back to the pool, so that later allocations
+* of the same size class reuse it. Blocks larger than XM_SMALL_MAX are
+* just left to the pool until it is destroyed.
+* @pool: the memory pool from which @ptr is allocated.
+* @ptr: the block, which must not be used anymore.
+* @size: the size @ptr was allocated with.
+*/
+void xmpool_free(struct xmpool_t * pool, void * ptr, size_t size);
+
+/*
+* Resize a block of @old_size bytes allocated from the pool to @size bytes.
+* The last allocation of the current chunk is resized in place if possible,
+* unless it was allocated before the last checkpoint, otherwise the contents
+* are copied to a new block and the old block is freed as by xmpool_free().
+* A large block allocated since the last checkpoint is resized by the
+* allocator of the pool instead.
+* Return: the address of the resized block on success, NULL on failure.
+* @pool: the memory pool from which @ptr is allocated.
+* @ptr: the block to resize, NULL to allocate a new one.
+* @old_size: the size @ptr was allocated or last resized with.
+* @size: the requested size of memory.
+*/
+void * xmpool_realloc(struct xmpool_t * pool, void * ptr,
+                      size_t old_size, size_t size);
+
+/*
+* Take a checkpoint of the pool, which xmpool_release() can roll it back to.
+* Return: the checkpoint.
+* @pool: the memory pool.
+*/
+struct xmpool_mark_t xmpool_mark(struct xmpool_t * pool);
+
+/*
+* Roll the pool back to a checkpoint taken by xmpool_mark(): everything
+* allocated after it is released at once. Large allocations are freed,
+* whole chunks are kept aside and reused by later allocations, so that
+* the pool does not grow beyond the peak between a mark and its release.
+* The memory allocated after the checkpoint must not be used anymore,
+* and checkpoints taken after it become invalid. The free lists are
+* emptied, the blocks on them are left to the pool.
+* @pool: the memory pool.
+* @mark: the checkpoint to roll back to.
+*/
+void xmpool_release(struct xmpool_t * pool, struct xmpool_mark_t * mark);
+
+/*
+* Tell how the memory of the pool is used.
+* @pool: the memory pool.
+* @usage: holds the result.
+*/
+void xmpool_usage(struct xmpool_t * pool, struct xmpool_usage_t * usage);
+
 /*
 * Frees up the memory occupied by the memory pool.
+* The chunks go to the chunk recycler if it is enabled.
 * @pool: the memory pool being destroyed.
 */
 void xmpool_destroy(struct xmpool_t * pool);
+
+/*
+* Enable the process-wide chunk recycler: the chunks of destroyed pools
+* are kept in a cache shared by all threads and reused by the pools
+* created later, so that steady-state parsing makes no calls into the
+* system allocator. Each thread keeps a few chunks of each size for
+* itself, the rest is shared up to @max_bytes.
+* Only pools using xmpool_default_allocator recycle their chunks.
+* @max_bytes: the most memory kept in the shared cache, 0 to disable
+*             the recycler (which is the default).
+*/
+void xmpool_recycler_enable(size_t max_bytes);
+
+/*
+* Free the chunks held by the shared cache and by the calling thread.
+* The chunks kept by other threads go to the shared cache as they exit.
+*/
+void xmpool_recycler_drain(void);
 #ifdef __cplusplus
 }
 #endif
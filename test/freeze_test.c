@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <xson/parser.h>
+
+#define N_MEMBERS 2000
+
+/*
+* A frozen object large enough for a perfect hash must get one,
+* and every key must still be found through it.
+*/
+int main(int argc, char const *argv[]){
+	char                *buf, *cp, key[32];
+	int                  i, bad = 0;
+	struct xson_context  ctx;
+	struct xson_element *root = NULL;
+	struct xson_object  *obj;
+
+	buf = cp = malloc(N_MEMBERS * 32 + 8);
+	*cp++ = '{';
+	for (i = 0; i < N_MEMBERS; ++i)
+		cp += sprintf(cp, "%s\"key_%d\":%d", i ? "," : "", i, i);
+	sprintf(cp, "}");
+
+	if (xson_init(&ctx, buf) != 0 || xson_parse(&ctx, &root) != XSON_RESULT_SUCCESS ||
+	    xson_freeze(&ctx) != XSON_RESULT_SUCCESS) {
+		printf("freeze_test: parse failed\n");
+		return 1;
+	}
+	obj = root->u.value.child->u.object;
+	if (obj->ht.seeds == NULL) {
+		printf("freeze_test: no perfect hash for %d members\n", N_MEMBERS);
+		bad = 1;
+	}
+	for (i = 0; i < N_MEMBERS + 100; ++i) {
+		sprintf(key, "key_%d", i);
+		if ((xson_object_get_pairval(obj, key) != NULL) != (i < N_MEMBERS)) {
+			printf("freeze_test: wrong lookup of %s\n", key);
+			bad = 1;
+		}
+	}
+
+	xson_destroy(&ctx);
+	free(buf);
+	printf("freeze_test: %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
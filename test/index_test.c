@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <xson/parser.h>
+
+#define N_RECORDS 4096
+#define ID_STEP   4096
+/* a bucket of a well spread hash holds a handful of entries at most */
+#define MAX_CHAIN 16
+
+/*
+* IDs in steps of a power of 2 must spread over the buckets of
+* a hash index, and every one of them must still be found.
+*/
+int main(int argc, char const *argv[]){
+	char                     *buf, *cp;
+	int                       i, e, n, longest = 0, bad = 0;
+	struct xson_context       ctx;
+	struct xson_element      *root = NULL;
+	struct xson_array_index  *index;
+
+	buf = cp = malloc(N_RECORDS * 32 + 8);
+	*cp++ = '[';
+	for (i = 0; i < N_RECORDS; ++i)
+		cp += sprintf(cp, "%s{\"ID\":%lld}", i ? "," : "", (long long)i * ID_STEP);
+	sprintf(cp, "]");
+
+	if (xson_init(&ctx, buf) != 0 || xson_parse(&ctx, &root) != XSON_RESULT_SUCCESS) {
+		printf("index_test: parse failed\n");
+		return 1;
+	}
+	index = xson_array_build_index(root->u.value.child->u.array, "ID",
+	                               XSON_ARRAY_INDEX_HASH);
+	if (index == NULL) {
+		printf("index_test: no index\n");
+		return 1;
+	}
+	for (i = 0; i <= (int)index->mask; ++i) {
+		for (n = 0, e = index->buckets[i]; e >= 0; e = index->entries[e].next)
+			++n;
+		if (n > longest)
+			longest = n;
+	}
+	if (longest > MAX_CHAIN) {
+		printf("index_test: %d IDs in a single bucket\n", longest);
+		bad = 1;
+	}
+	for (i = 0; i < N_RECORDS; ++i) {
+		if (xson_array_index_find_llong(index, (long long)i * ID_STEP) != i ||
+		    xson_array_index_find_llong(index, (long long)i * ID_STEP + 1) !=
+		    XSON_RESULT_KEY_NOT_EXIST) {
+			printf("index_test: wrong lookup of %lld\n", (long long)i * ID_STEP);
+			bad = 1;
+			break;
+		}
+	}
+
+	xson_array_index_free(index);
+	xson_destroy(&ctx);
+	free(buf);
+	printf("index_test: %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
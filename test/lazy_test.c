@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <xson/parser.h>
+#include <xson/lazy.h>
+#include <xson/path.h>
+
+#define DOC \
+	"{\"pre\":{\"s\":\"]}{[\\\"\",\"x\":[1,{\"y\":[2,[3,{}]]}],\"z\":{\"deep\":{\"k\":1}}}," \
+	" \"a\\\"b\" : 5 ," \
+	"\"target\":{\"v\":\"s\\\"q\\u0041\",\"n\":-1.5e3,\"arr\":[1,\"two\",{\"three\":3}]}," \
+	"\"last\":[[],{}]"
+/* xson_parse() does not take booleans in arrays, xson_parse_lazy() does */
+#define FLAGS ",\"flags\":[true,1]"
+
+/* looked up in the document, with xson_lazy_get() and xson_path_eval() */
+static const char *exprs[] = {
+	"target.v",
+	"target.n",
+	"target.arr[1]",
+	"target.arr[2].three",
+	"a\\\"b",
+	"pre.s",
+	"pre.x[1].y[1][0]",
+	"pre.z.deep.k",
+	"last[0]",
+	"target.missing",
+	"target.arr[3]",
+	"target.v.no",
+};
+
+/* not a single valid object or array */
+static const char *invalid[] = {
+	"{\"a\":1} x",
+	"{\"a\":1}{}",
+	"[1,2] ]",
+	"{\"a\":1,}",
+	"[1,2,]",
+	"{\"a\" 1}",
+	"{\"a\":\"\\x\"}",
+	"[01]",
+	"[1",
+	"",
+};
+
+/*
+* Return: 1 if @a and @b are the same error or elements of the same type
+*         spanning the same text, 0 otherwise.
+*/
+static int same(struct xson_element *a, struct xson_element *b){
+	if (!XSON_GOOD_ELEMENT(a) || !XSON_GOOD_ELEMENT(b))
+		return a == b;
+	if (a->type != b->type)
+		return 0;
+	if (a->type == ELE_TYPE_NUMBER || a->type == ELE_TYPE_STRING)
+		return a->u.string.end - a->u.string.start ==
+		       b->u.string.end - b->u.string.start &&
+		       !memcmp(a->u.string.start, b->u.string.start,
+		               a->u.string.end + 1 - a->u.string.start);
+	if (a->type == ELE_TYPE_OBJECT)
+		return xson_object_get_size(a->u.object) == xson_object_get_size(b->u.object);
+	if (a->type == ELE_TYPE_ARRAY)
+		return xson_array_get_size(a->u.array) == xson_array_get_size(b->u.array);
+	return 1;
+}
+
+/*
+* The lazy parse accepts what xson_parse() accepts, and the elements
+* it materializes are the ones xson_parse() builds.
+*/
+int main(int argc, char const *argv[]){
+	char                 lazy_doc[] = DOC FLAGS "}", full_doc[] = DOC "}", buf[64];
+	int                  i, bad = 0;
+	struct xson_context  lazy, full, ctx;
+	struct xson_element *root = NULL, *a, *b;
+	struct xson_path    *path;
+
+	if (xson_init(&lazy, lazy_doc) != 0 || xson_parse_lazy(&lazy) != XSON_RESULT_SUCCESS ||
+	    xson_init(&full, full_doc) != 0 || xson_parse(&full, &root) != XSON_RESULT_SUCCESS) {
+		printf("lazy_test: parse failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < (int)(sizeof(exprs) / sizeof(exprs[0])); ++i) {
+		if ((path = xson_path_compile(exprs[i])) == NULL) {
+			printf("lazy_test: %s does not compile\n", exprs[i]);
+			bad = 1;
+			continue;
+		}
+		a = xson_lazy_eval(&lazy, path);
+		b = xson_path_eval(root, path);
+		xson_path_free(path);
+		if (!same(a, b)) {
+			printf("lazy_test: %s differs\n", exprs[i]);
+			bad = 1;
+		}
+	}
+	/* found, not just failing the same way */
+	a = xson_lazy_get(&lazy, "a\\\"b");
+	if (!XSON_GOOD_ELEMENT(a) || a->type != ELE_TYPE_NUMBER || *a->u.number.start != '5') {
+		printf("lazy_test: escaped key not found\n");
+		bad = 1;
+	}
+	a = xson_lazy_get(&lazy, "target.arr[2].three");
+	if (!XSON_GOOD_ELEMENT(a) || a->type != ELE_TYPE_NUMBER) {
+		printf("lazy_test: nested containers not skipped\n");
+		bad = 1;
+	}
+	if (xson_lazy_get(&lazy, "flags") != XSON_EXPR_OP_NOTSUPPORTED) {
+		printf("lazy_test: an array of true is materialized\n");
+		bad = 1;
+	}
+	a = xson_lazy_get(&lazy, "target.v");
+	if (xson_get_string_by_expr(root, "target.v", buf, sizeof(buf)) != XSON_RESULT_SUCCESS ||
+	    !XSON_GOOD_ELEMENT(a) ||
+	    xson_string_to_buf(&a->u.string, buf + 32, 32) != XSON_RESULT_SUCCESS ||
+	    strcmp(buf, buf + 32)) {
+		printf("lazy_test: strings differ\n");
+		bad = 1;
+	}
+
+	for (i = 0; i < (int)(sizeof(invalid) / sizeof(invalid[0])); ++i) {
+		strcpy(buf, invalid[i]);
+		if (xson_init(&ctx, buf) != 0)
+			continue;
+		if (xson_parse_lazy(&ctx) != XSON_RESULT_INVALID_JSON) {
+			printf("lazy_test: %s is accepted\n", invalid[i]);
+			bad = 1;
+		}
+		xson_destroy(&ctx);
+	}
+
+	xson_destroy(&lazy);
+	xson_destroy(&full);
+	printf("lazy_test: %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
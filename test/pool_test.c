@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include <xson/parser.h>
+
+#define N_BLOCKS  64
+#define N_ROUNDS  200
+/* pools of the thread that only takes chunks, fewer than a magazine holds */
+#define N_TAKEN   2
+/* what a thread exiting may leave behind, its magazines are given back */
+#define MAX_KEPT  (32 << 10)
+
+struct block {
+	unsigned char *p;
+	size_t size;
+};
+
+/*
+* Return: 1 if the blocks overlap each other, or @live which must
+*         not be handed out again, 0 otherwise.
+*/
+static int overlap(struct block *b, int n, struct block *live){
+	int i, j;
+
+	for (i = 0; i < n; ++i) {
+		if (b[i].p < live->p + live->size && live->p < b[i].p + b[i].size)
+			return 1;
+		for (j = 0; j < i; ++j)
+			if (b[i].p < b[j].p + b[j].size && b[j].p < b[i].p + b[i].size)
+				return 1;
+	}
+	return 0;
+}
+
+/*
+* Blocks allocated before a checkpoint outlive its release, blocks older
+* than it are not grown in place, and the free lists filled after it
+* are emptied by the release.
+*/
+static int checkpoints(void){
+	int                   i, bad = 0;
+	struct xmpool_t       pool;
+	struct xmpool_mark_t  outer, inner;
+	struct block          live, b[N_BLOCKS];
+	unsigned char        *old, *grown, *p;
+
+	xmpool_init(&pool, XM_CHUNK_SIZE);
+	live.size = 64;
+	live.p = xmpool_alloc(&pool, live.size);
+	memset(live.p, 'l', live.size);
+	old = xmpool_alloc(&pool, 64);
+
+	outer = xmpool_mark(&pool);
+	/* the last allocation, but older than the checkpoint */
+	grown = xmpool_realloc(&pool, old, 64, 256);
+	if (grown == old) {
+		printf("pool_test: a block older than the checkpoint grew in place\n");
+		bad = 1;
+	}
+	memset(grown, 'g', 256);
+
+	inner = xmpool_mark(&pool);
+	p = xmpool_alloc(&pool, 32);
+	/* newer than the inner checkpoint, grows in place */
+	if (xmpool_realloc(&pool, p, 32, 48) != p) {
+		printf("pool_test: a block newer than the checkpoint was moved\n");
+		bad = 1;
+	}
+	xmpool_release(&pool, &inner);
+	/* the outer checkpoint is the floor again */
+	if (xmpool_realloc(&pool, grown, 256, 512) != grown) {
+		printf("pool_test: the checkpoint was not restored\n");
+		bad = 1;
+	}
+
+	/* free list entries pointing past the checkpoint */
+	for (i = 0; i < N_BLOCKS; ++i) {
+		p = xmpool_alloc(&pool, 8 * (i % 16 + 1));
+		xmpool_free(&pool, p, 8 * (i % 16 + 1));
+	}
+	xmpool_release(&pool, &outer);
+
+	for (i = 0; i < N_BLOCKS; ++i) {
+		b[i].size = 8 * (i % 16 + 1);
+		b[i].p = xmpool_alloc(&pool, b[i].size);
+		memset(b[i].p, 0, b[i].size);
+	}
+	if (overlap(b, N_BLOCKS, &live)) {
+		printf("pool_test: live memory handed out after a release\n");
+		bad = 1;
+	}
+	for (i = 0; i < (int)live.size && live.p[i] == 'l'; ++i)
+		;
+	if (i < (int)live.size) {
+		printf("pool_test: a block older than the checkpoint was overwritten\n");
+		bad = 1;
+	}
+
+	xmpool_destroy(&pool);
+	return bad;
+}
+
+/* pools filled with a pattern of their own, to detect a chunk handed twice */
+static void *churn(void *arg){
+	int              i, j, fill = *(int *)arg;
+	size_t           k;
+	struct xmpool_t  pool;
+	struct block     b[N_BLOCKS];
+
+	for (i = 0; i < N_ROUNDS; ++i) {
+		xmpool_init(&pool, XM_CHUNK_SIZE);
+		for (j = 0; j < N_BLOCKS; ++j) {
+			b[j].size = 128 + 64 * j;
+			if ((b[j].p = xmpool_alloc(&pool, b[j].size)) == NULL)
+				return arg;
+			memset(b[j].p, fill, b[j].size);
+		}
+		for (j = 0; j < N_BLOCKS; ++j)
+			for (k = 0; k < b[j].size; ++k)
+				if (b[j].p[k] != fill)
+					return arg;
+		xmpool_destroy(&pool);
+	}
+	return NULL;
+}
+
+/* a thread that only takes chunks, its pools are destroyed elsewhere */
+static struct xmpool_t taken[N_BLOCKS];
+
+static void *take(void *arg){
+	int i;
+
+	for (i = 0; i < N_TAKEN; ++i) {
+		xmpool_init(&taken[i], XM_CHUNK_SIZE);
+		xmpool_alloc(&taken[i], 64);
+	}
+	return NULL;
+}
+
+static size_t allocated(void){
+	struct mallinfo2 mi = mallinfo2();
+
+	return mi.uordblks + mi.hblkhd;
+}
+
+/*
+* Two threads recycle chunks at once, and the chunks kept by a thread
+* go back to the shared cache when it exits.
+*/
+static int recycler(void){
+	int        i, round, bad = 0, fills[2] = { 0x5a, 0xa5 };
+	size_t     before;
+	pthread_t  t[2];
+	void      *res;
+
+	xmpool_recycler_enable(64 << 20);
+	for (i = 0; i < 2; ++i)
+		pthread_create(&t[i], NULL, churn, &fills[i]);
+	for (i = 0; i < 2; ++i) {
+		pthread_join(t[i], &res);
+		if (res) {
+			printf("pool_test: a chunk was used by two pools\n");
+			bad = 1;
+		}
+	}
+	xmpool_recycler_drain();
+
+	before = allocated();
+	for (i = 0; i < N_BLOCKS; ++i)
+		xmpool_init(&taken[i], XM_CHUNK_SIZE);
+	for (i = 0; i < N_BLOCKS; ++i)
+		xmpool_destroy(&taken[i]);
+	for (round = 0; round < 3; ++round) {
+		pthread_create(&t[0], NULL, take, NULL);
+		pthread_join(t[0], NULL);
+		for (i = 0; i < N_TAKEN; ++i)
+			xmpool_destroy(&taken[i]);
+	}
+	xmpool_recycler_drain();
+	if (allocated() > before + MAX_KEPT) {
+		printf("pool_test: %zu bytes kept by exited threads\n",
+		       allocated() - before);
+		bad = 1;
+	}
+	xmpool_recycler_enable(0);
+	return bad;
+}
+
+int main(int argc, char const *argv[]){
+	int bad;
+
+	bad = checkpoints();
+	bad |= recycler();
+	printf("pool_test: %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <xson/parser.h>
+#include <xson/path.h>
+
+#define DOC \
+	"{\"name\":\"n\",\"other\":[{\"id\":9}]," \
+	"\"items\":[" \
+	"{\"junk\":{\"a\":[1,{\"b\":\"}]\\\"\"}]},\"id\":1,\"meta\":{\"tags\":[\"x\"],\"skip\":2}}," \
+	"{\"id\":2,\"junk\":\"]\",\"meta\":{\"skip\":{\"c\":[]},\"tags\":[]}}," \
+	"{\"junk\":null,\"meta\":{\"tags\":[\"y\",{\"z\":[3]}]},\"id\":3}," \
+	"{\"id\":4}]," \
+	"\"last\":{\"id\":5}}"
+
+/* what is kept */
+static const char *projected[] = {
+	"name",
+	"items.id",
+	"items[0].meta.tags",
+};
+
+/* found alike in both documents */
+static const char *kept[] = {
+	"name",
+	"items[0].id", "items[1].id", "items[2].id", "items[3].id",
+	"items[0].meta.tags", "items[1].meta.tags", "items[2].meta.tags",
+	"items[0].meta.tags[0]", "items[2].meta.tags[1].z[0]",
+};
+
+/* only found in the whole document */
+static const char *skipped[] = {
+	"other",
+	"last",
+	"items[0].junk", "items[1].junk", "items[2].junk",
+	"items[0].meta.skip", "items[1].meta.skip",
+};
+
+/*
+* Return: 1 if @a and @b are elements of the same type spanning the same
+*         text, or containers of the same size, 0 otherwise.
+*/
+static int same(struct xson_element *a, struct xson_element *b){
+	if (!XSON_GOOD_ELEMENT(a) || !XSON_GOOD_ELEMENT(b) || a->type != b->type)
+		return 0;
+	if (a->type == ELE_TYPE_NUMBER || a->type == ELE_TYPE_STRING)
+		return a->u.string.end - a->u.string.start ==
+		       b->u.string.end - b->u.string.start &&
+		       !memcmp(a->u.string.start, b->u.string.start,
+		               a->u.string.end + 1 - a->u.string.start);
+	if (a->type == ELE_TYPE_OBJECT)
+		return xson_object_get_size(a->u.object) == xson_object_get_size(b->u.object);
+	if (a->type == ELE_TYPE_ARRAY)
+		return xson_array_get_size(a->u.array) == xson_array_get_size(b->u.array);
+	return 1;
+}
+
+static struct xson_element *eval(struct xson_element *root, const char *expr){
+	struct xson_path    *path = xson_path_compile(expr);
+	struct xson_element *elt;
+
+	if (path == NULL)
+		return XSON_EXPR_INVALID_EXPR;
+	elt = xson_path_eval(root, path);
+	xson_path_free(path);
+	return elt;
+}
+
+/*
+* A projected parse finds the values on the projection as the whole parse
+* does, whatever was skipped around them, and nothing else.
+*/
+int main(int argc, char const *argv[]){
+	char                     proj_doc[] = DOC, full_doc[] = DOC, expr[16];
+	int                      i, bad = 0;
+	struct xson_context      proj, full;
+	struct xson_element     *proj_root = NULL, *full_root = NULL, *elt;
+	struct xson_projection  *projection;
+
+	projection = xson_projection_compile(projected, sizeof(projected) / sizeof(projected[0]));
+	if (projection == NULL ||
+	    xson_init(&proj, proj_doc) != 0 ||
+	    xson_parse_projected(&proj, projection, &proj_root) != XSON_RESULT_SUCCESS ||
+	    xson_init(&full, full_doc) != 0 ||
+	    xson_parse(&full, &full_root) != XSON_RESULT_SUCCESS) {
+		printf("projection_test: parse failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < (int)(sizeof(kept) / sizeof(kept[0])); ++i) {
+		if (!same(eval(proj_root, kept[i]), eval(full_root, kept[i]))) {
+			printf("projection_test: %s differs\n", kept[i]);
+			bad = 1;
+		}
+	}
+	for (i = 0; i < (int)(sizeof(skipped) / sizeof(skipped[0])); ++i) {
+		if (!XSON_GOOD_ELEMENT(eval(full_root, skipped[i])) ||
+		    eval(proj_root, skipped[i]) != XSON_EXPR_KEY_NOT_EXIST) {
+			printf("projection_test: %s is kept\n", skipped[i]);
+			bad = 1;
+		}
+	}
+	/* the records keep the id and the meta with its tags only */
+	for (i = 0; i < 3; ++i) {
+		sprintf(expr, "items[%d]", i);
+		elt = eval(proj_root, expr);
+		if (!XSON_GOOD_ELEMENT(elt) || xson_object_get_size(elt->u.object) != 2) {
+			printf("projection_test: items[%d] has other members\n", i);
+			bad = 1;
+		}
+	}
+
+	xson_destroy(&proj);
+	xson_destroy(&full);
+	xson_projection_free(projection);
+	printf("projection_test: %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
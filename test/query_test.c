@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <xson/parser.h>
+#include <xson/query.h>
+
+#define DOC \
+	"{\"store\":{\"book\":[" \
+	"{\"title\":\"A\",\"price\":8.95,\"isbn\":\"x1\",\"tags\":[\"a\",\"b\"]}," \
+	"{\"title\":\"B\",\"price\":12.99,\"used\":true}," \
+	"{\"title\":\"C\",\"price\":8.99,\"used\":false,\"isbn\":null}," \
+	"{\"title\":\"D\",\"price\":22.99}]," \
+	"\"bicycle\":{\"color\":\"red\",\"price\":19.95}}," \
+	"\"n\":[0,1,2,3,4,5]}"
+
+/* an expression and its matches as written in the document, {} and [] for containers */
+static const struct {
+	const char *expr;
+	const char *matches;
+} cases[] = {
+	/* slices */
+	{ "$.n[1:3]",                                 "1 2" },
+	{ "$.n[-2:]",                                 "4 5" },
+	{ "$.n[:2]",                                  "0 1" },
+	{ "$.n[:-4]",                                 "0 1" },
+	{ "$.n[::2]",                                 "0 2 4" },
+	{ "$.n[::-1]",                                "5 4 3 2 1 0" },
+	{ "$.n[4:1:-2]",                              "4 2" },
+	{ "$.n[-1]",                                  "5" },
+	{ "$.n[10]",                                  "" },
+	{ "$.n[10:]",                                 "" },
+	/* keys and wildcards */
+	{ "$.store.bicycle.color",                    "red" },
+	{ "$['store']['bicycle'][\"price\"]",         "19.95" },
+	{ "$.store.bicycle.*",                        "red 19.95" },
+	{ "$.store.book[*].title",                    "A B C D" },
+	{ "store.book[1].title",                      "B" },
+	/* descendants */
+	{ "$..price",                                 "8.95 12.99 8.99 22.99 19.95" },
+	{ "$.store.book[0]..*",                       "A 8.95 x1 [] a b" },
+	{ "$..[1]",                                   "{} b 1" },
+	{ "$..nothing",                               "" },
+	/* filters on a member */
+	{ "$.store.book[?(@.price < 10)].title",      "A C" },
+	{ "$.store.book[?(@.price <= 8.99)].title",   "A C" },
+	{ "$.store.book[?(@.price > 12.99)].title",   "D" },
+	{ "$.store.book[?(@.price >= 12.99)].title",  "B D" },
+	{ "$.store.book[?(@.price == 8.99)].title",   "C" },
+	{ "$.store.book[?(@.price != 8.99)].title",   "A B D" },
+	{ "$.store.book[?(@.title == 'B')].price",    "12.99" },
+	{ "$.store.book[?(@.title != \"B\")].price",  "8.95 8.99 22.99" },
+	{ "$.store.book[?(@.title < 'C')].price",     "8.95 12.99" },
+	{ "$.store.book[?(@.used == true)].title",    "B" },
+	{ "$.store.book[?(@.used == false)].title",   "C" },
+	{ "$.store.book[?(@.used != true)].title",    "C" },
+	{ "$.store.book[?(@.isbn == null)].title",    "C" },
+	{ "$.store.book[?(@.isbn != null)].title",    "A" },
+	{ "$.store.book[?(@.isbn)].title",            "A C" },
+	{ "$.store.book[?(@.tags[1] == 'b')].title",  "A" },
+	/* filters on the candidate itself */
+	{ "$.n[?(@ > 3)]",                            "4 5" },
+	{ "$.n[?(@ == 'x')]",                         "" },
+	{ "$.store.book[0].tags[?(@ >= 'b')]",        "b" },
+	{ "$.store.bicycle[?(@ == 'red')]",           "red" },
+};
+
+/* expressions that do not compile */
+static const char *invalid[] = {
+	"$..",
+	"$a",
+	"$.n[1:2:0]",
+	"$['abc",
+	"$['abc']x",
+	"$.n[",
+	"$.n[?(@.a == 'x)]",
+	"$.n[?(@.a ~ 1)]",
+	"$.",
+};
+
+struct matches {
+	char buf[256];
+	int n, stop_after;
+};
+
+static int collect(struct xson_element *elt, void *arg){
+	struct matches *m = arg;
+	char           *cp = m->buf + strlen(m->buf);
+
+	if (m->n++)
+		*cp++ = ' ';
+	switch (elt->type) {
+	case ELE_TYPE_NUMBER:
+	case ELE_TYPE_STRING:
+		sprintf(cp, "%.*s", (int)(elt->u.string.end + 1 - elt->u.string.start),
+		        elt->u.string.start);
+		break;
+	case ELE_TYPE_BOOL:
+		strcpy(cp, elt->u.xbool.bool_val ? "true" : "false");
+		break;
+	case ELE_TYPE_NULL:
+		strcpy(cp, "null");
+		break;
+	case ELE_TYPE_OBJECT:
+		strcpy(cp, "{}");
+		break;
+	default:
+		strcpy(cp, "[]");
+		break;
+	}
+	return m->n == m->stop_after ? XSON_VISIT_STOP : XSON_VISIT_CONTINUE;
+}
+
+/*
+* Every form of the JSONPath subset selects the elements it should,
+* in document order, and the malformed expressions are rejected.
+*/
+int main(int argc, char const *argv[]){
+	char                 doc[] = DOC;
+	int                  i, rc, bad = 0;
+	struct xson_context  ctx;
+	struct xson_element *root = NULL;
+	struct xson_query   *query;
+	struct matches       m;
+
+	if (xson_init(&ctx, doc) != 0 || xson_parse(&ctx, &root) != XSON_RESULT_SUCCESS) {
+		printf("query_test: parse failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i) {
+		memset(&m, 0, sizeof(m));
+		if ((query = xson_query_compile(cases[i].expr)) == NULL) {
+			printf("query_test: %s does not compile\n", cases[i].expr);
+			bad = 1;
+			continue;
+		}
+		rc = xson_query_exec(root, query, collect, &m);
+		if (rc != XSON_RESULT_SUCCESS || strcmp(m.buf, cases[i].matches)) {
+			printf("query_test: %s gives \"%s\" (%d), not \"%s\"\n",
+			       cases[i].expr, m.buf, rc, cases[i].matches);
+			bad = 1;
+		}
+		xson_query_free(query);
+	}
+
+	/* the callback stops the query at the second match */
+	memset(&m, 0, sizeof(m));
+	m.stop_after = 2;
+	query = xson_query_compile("$..price");
+	rc = xson_query_exec(root, query, collect, &m);
+	if (rc != XSON_VISIT_STOP || strcmp(m.buf, "8.95 12.99")) {
+		printf("query_test: stopped query gives \"%s\" (%d)\n", m.buf, rc);
+		bad = 1;
+	}
+	xson_query_free(query);
+
+	for (i = 0; i < (int)(sizeof(invalid) / sizeof(invalid[0])); ++i) {
+		if ((query = xson_query_compile(invalid[i])) != NULL) {
+			printf("query_test: %s compiles\n", invalid[i]);
+			xson_query_free(query);
+			bad = 1;
+		}
+	}
+
+	xson_destroy(&ctx);
+	printf("query_test: %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}